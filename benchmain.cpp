@@ -0,0 +1,339 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+#include <QRandomGenerator>
+#include <QSysInfo>
+#include <QThread>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QFile>
+#include <QDir>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include "fileprocessor.h"
+#include "xorkernel.h"
+#include "bufferpool.h"
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const quint64 BENCH_KEY = Q_UINT64_C(0x0123456789abcdef);
+// Odd and not a divisor of any vector width, so the keystream period is at its least friendly.
+const int BENCH_LONG_KEY_SIZE = 37;
+const quint64 BENCH_UNIFORM_KEY = Q_UINT64_C(0x5a5a5a5a5a5a5a5a);
+
+struct DatasetSpec
+{
+    QString name;
+    int fileCount;
+    qint64 minSize;
+    qint64 maxSize;
+    int hugeCount;
+    qint64 hugeSize;
+};
+
+double gigabytesPerSecond(qint64 bytes, qint64 elapsedNs)
+{
+    return elapsedNs > 0 ? double(bytes) / double(elapsedNs) : 0.0;
+}
+
+double percentile(std::vector<qint64> values, double fraction)
+{
+    if (values.empty()) {
+        return 0.0;
+    }
+    std::sort(values.begin(), values.end());
+    const size_t index = std::min(values.size() - 1, size_t(std::ceil(fraction * values.size())) - 1);
+    return values[index] / 1e6;
+}
+
+// Runs `variant` over `size` bytes with src and dst misaligned by their own offsets until
+// enough time has passed.
+QJsonObject benchmarkKernel(XorKernel::Variant variant, const XorKey &key, qint64 size, int srcAlignment,
+                            int dstAlignment, qint64 minTimeNs)
+{
+    const qint64 padding = BufferPool::ALIGNMENT;
+    char *src = BufferPool::allocateAligned(size + padding);
+    char *dst = BufferPool::allocateAligned(size + padding);
+    std::fill(src, src + size + padding, char(0x5a));
+
+    const XorKernel::Function function = XorKernel::function(variant, key.kind());
+
+    qint64 iterations = 0;
+    QElapsedTimer timer;
+    timer.start();
+    do {
+        for (int i = 0; i < 16; ++i) {
+            function(src + srcAlignment, dst + dstAlignment, size, key.keystream(), key.period(), iterations + i);
+        }
+        iterations += 16;
+    } while (timer.nsecsElapsed() < minTimeNs);
+    const qint64 elapsedNs = timer.nsecsElapsed();
+
+    BufferPool::freeAligned(src);
+    BufferPool::freeAligned(dst);
+
+    QJsonObject result;
+    result["variant"] = XorKernel::variantName(variant);
+    result["keySize"] = key.size();
+    result["uniformKey"] = key.kind() == XorKey::UniformKey;
+    result["size"] = size;
+    result["srcAlignment"] = srcAlignment;
+    result["dstAlignment"] = dstAlignment;
+    result["iterations"] = iterations;
+    result["gbps"] = gigabytesPerSecond(size * iterations, elapsedNs);
+    return result;
+}
+
+// The end-to-end runs should read from the disk, not from the pages the dataset was just
+// written through, so each file is synced and evicted. Returns false when that isn't possible.
+bool dropFromCache(QFile &file)
+{
+#ifdef Q_OS_LINUX
+    return file.flush() && ::fsync(file.handle()) == 0
+        && ::posix_fadvise(file.handle(), 0, 0, POSIX_FADV_DONTNEED) == 0;
+#else
+    Q_UNUSED(file)
+    return false;
+#endif
+}
+
+bool writeFile(const QString &path, qint64 size, QByteArray &block, bool *coldCache)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    for (qint64 written = 0; written < size;) {
+        const qint64 chunk = qMin<qint64>(block.size(), size - written);
+        if (file.write(block.constData(), chunk) != chunk) {
+            return false;
+        }
+        written += chunk;
+    }
+    if (!dropFromCache(file)) {
+        *coldCache = false;
+    }
+    return true;
+}
+
+// Sizes are log-uniform between minSize and maxSize so the set mixes small and large files.
+qint64 generateDataset(const DatasetSpec &spec, const QString &path, quint32 seed, bool *coldCache)
+{
+    QDir().mkpath(path);
+    QRandomGenerator random(seed);
+
+    QByteArray block(4 * 1024 * 1024, Qt::Uninitialized);
+    for (int i = 0; i < block.size(); ++i) {
+        block[i] = char(random.generate());
+    }
+
+    const double logMin = std::log(double(spec.minSize));
+    const double logMax = std::log(double(spec.maxSize));
+
+    qint64 totalBytes = 0;
+    for (int i = 0; i < spec.fileCount; ++i) {
+        const qint64 size = qint64(std::exp(logMin + random.generateDouble() * (logMax - logMin)));
+        if (!writeFile(QString("%1/file%2.bin").arg(path).arg(i), size, block, coldCache)) {
+            return -1;
+        }
+        totalBytes += size;
+    }
+    for (int i = 0; i < spec.hugeCount; ++i) {
+        if (!writeFile(QString("%1/huge%2.bin").arg(path).arg(i), spec.hugeSize, block, coldCache)) {
+            return -1;
+        }
+        totalBytes += spec.hugeSize;
+    }
+
+    return totalBytes;
+}
+
+QJsonObject benchmarkEndToEnd(const DatasetSpec &spec, const QString &workPath, const FileProcessorSettings &baseSettings)
+{
+    QJsonObject result;
+    result["dataset"] = spec.name;
+
+    const QString inputPath = workPath + "/" + spec.name + "-in";
+    const QString outputPath = workPath + "/" + spec.name + "-out";
+
+    bool coldCache = true;
+    const qint64 totalBytes = generateDataset(spec, inputPath, 1, &coldCache);
+    if (totalBytes < 0) {
+        result["error"] = "dataset generation failed";
+        return result;
+    }
+
+    FileProcessorSettings settings = baseSettings;
+    settings.inputPath = inputPath;
+    settings.outputPath = outputPath;
+    settings.fileMask = "*.bin";
+    settings.key = XorKey::fromWord(BENCH_KEY);
+
+    QMutex latenciesMutex;
+    std::vector<qint64> latencies;
+    int failedCount = 0;
+
+    FileProcessor processor;
+    processor.setSettings(settings);
+    QObject::connect(&processor, &FileProcessor::fileProcessed, &processor,
+                     [&](const QString &, qint64 elapsedNs, bool ok) {
+                         QMutexLocker locker(&latenciesMutex);
+                         latencies.push_back(elapsedNs);
+                         if (!ok) {
+                             failedCount++;
+                         }
+                     },
+                     Qt::DirectConnection);
+
+    QElapsedTimer timer;
+    timer.start();
+    processor.start();
+    processor.wait();
+    const qint64 elapsedNs = timer.nsecsElapsed();
+
+    const int fileCount = spec.fileCount + spec.hugeCount;
+    result["files"] = fileCount;
+    // False when the dataset could not be evicted, so the reads were served from memory.
+    result["coldCache"] = coldCache;
+    result["failed"] = failedCount;
+    result["bytes"] = totalBytes;
+    result["seconds"] = elapsedNs / 1e9;
+    result["gbps"] = gigabytesPerSecond(totalBytes, elapsedNs);
+    result["filesPerSecond"] = elapsedNs > 0 ? fileCount * 1e9 / elapsedNs : 0.0;
+    result["latencyP50Ms"] = percentile(latencies, 0.50);
+    result["latencyP99Ms"] = percentile(latencies, 0.99);
+
+    QDir(inputPath).removeRecursively();
+    QDir(outputPath).removeRecursively();
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    app.setApplicationName("fileprocessor_bench");
+    app.setApplicationVersion("1.0");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Kernel and end-to-end throughput benchmarks");
+    parser.addHelpOption();
+    parser.addOptions({
+        { "json", "Write results to this file instead of stdout.", "file" },
+        { "work-dir", "Directory for the synthetic datasets (default: system temp).", "path" },
+        { "scale", "Multiply dataset file counts and sizes by this factor (default: 1).", "factor" },
+        { "kernel-only", "Run only the XOR kernel microbenchmarks." },
+        { "e2e-only", "Run only the end-to-end benchmarks." },
+        { "engine", "I/O engine for end-to-end runs: buffered, mmap or uring.", "engine" },
+        { "workers", "Worker threads for end-to-end runs, 0 = auto.", "count" },
+    });
+    parser.process(app);
+
+    const double scale = parser.isSet("scale") ? parser.value("scale").toDouble() : 1.0;
+    if (scale <= 0.0) {
+        std::fprintf(stderr, "Invalid --scale\n");
+        return 2;
+    }
+
+    QJsonObject report;
+    QJsonObject system;
+    system["cpu"] = QSysInfo::currentCpuArchitecture();
+    system["os"] = QSysInfo::prettyProductName();
+    system["threads"] = QThread::idealThreadCount();
+    system["bestKernel"] = XorKernel::variantName(XorKernel::bestVariant());
+    report["system"] = system;
+
+    if (!parser.isSet("e2e-only")) {
+        const XorKernel::Variant variants[] = { XorKernel::Scalar, XorKernel::Word64, XorKernel::Sse2,
+                                                XorKernel::Avx2, XorKernel::Avx512 };
+        const qint64 sizes[] = { 64, 4096, 64 * 1024, 1024 * 1024, 16 * 1024 * 1024 };
+        // Equal offsets keep src and dst mutually aligned; the rest are not.
+        const int alignments[][2] = { { 0, 0 }, { 1, 1 }, { 8, 8 }, { 13, 13 }, { 0, 13 }, { 13, 0 }, { 1, 8 } };
+
+        QByteArray longKey(BENCH_LONG_KEY_SIZE, Qt::Uninitialized);
+        for (int i = 0; i < longKey.size(); ++i) {
+            longKey[i] = char(0x11 * (i + 1));
+        }
+        const XorKey keys[] = { XorKey::fromWord(BENCH_KEY), XorKey(longKey), XorKey::fromWord(BENCH_UNIFORM_KEY) };
+
+        QJsonArray kernel;
+        for (XorKernel::Variant variant : variants) {
+            if (!XorKernel::isSupported(variant)) {
+                continue;
+            }
+            for (const XorKey &key : keys) {
+                for (qint64 size : sizes) {
+                    for (const auto &alignment : alignments) {
+                        kernel.append(benchmarkKernel(variant, key, size, alignment[0], alignment[1],
+                                                      100 * 1000 * 1000));
+                    }
+                }
+            }
+        }
+        report["kernel"] = kernel;
+    }
+
+    if (!parser.isSet("kernel-only")) {
+        auto scaled = [scale](qint64 value) { return qMax<qint64>(1, qint64(value * scale)); };
+
+        const DatasetSpec datasets[] = {
+            { "tiny", int(scaled(20000)), 512, 16 * 1024, 0, 0 },
+            { "huge", 0, 1, 1, int(qMax<qint64>(2, scaled(4))), scaled(512LL * 1024 * 1024) },
+            { "mixed", int(scaled(2000)), 1024, scaled(8LL * 1024 * 1024), 2, scaled(128LL * 1024 * 1024) },
+        };
+
+        FileProcessorSettings settings;
+        settings.workerCount = parser.isSet("workers") ? parser.value("workers").toInt() : 0;
+        const QString engine = parser.value("engine");
+        if (engine == "mmap") {
+            settings.ioEngine = FileProcessorSettings::MemoryMappedIo;
+        } else if (engine == "uring") {
+            settings.ioEngine = FileProcessorSettings::UringIo;
+        }
+
+        QTemporaryDir workDir(parser.isSet("work-dir") ? parser.value("work-dir") + "/fileprocessor-bench-XXXXXX"
+                                                       : QDir::tempPath() + "/fileprocessor-bench-XXXXXX");
+        if (!workDir.isValid()) {
+            std::fprintf(stderr, "Cannot create work directory\n");
+            return 1;
+        }
+
+        QJsonArray endToEnd;
+        for (const DatasetSpec &spec : datasets) {
+            endToEnd.append(benchmarkEndToEnd(spec, workDir.path(), settings));
+        }
+
+        QJsonObject endToEndReport;
+        endToEndReport["engine"] = engine.isEmpty() ? "buffered" : engine;
+        endToEndReport["workers"] = settings.workerCount;
+        endToEndReport["scale"] = scale;
+        endToEndReport["results"] = endToEnd;
+        report["endToEnd"] = endToEndReport;
+    }
+
+    const QByteArray json = QJsonDocument(report).toJson(QJsonDocument::Indented);
+    if (parser.isSet("json")) {
+        QFile file(parser.value("json"));
+        if (!file.open(QIODevice::WriteOnly) || file.write(json) != json.size()) {
+            std::fprintf(stderr, "Cannot write %s\n", qPrintable(parser.value("json")));
+            return 1;
+        }
+    } else {
+        std::fwrite(json.constData(), 1, json.size(), stdout);
+    }
+
+    return 0;
+}
@@ -0,0 +1,82 @@
+#ifndef BLOCKINGQUEUE_H
+#define BLOCKINGQUEUE_H
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QQueue>
+#include <QWaitCondition>
+
+template <typename T>
+class BlockingQueue
+{
+public:
+    explicit BlockingQueue(int capacity = 0)
+        : m_capacity(capacity)
+        , m_closed(false)
+    {
+    }
+
+    bool push(const T &item)
+    {
+        QMutexLocker locker(&m_mutex);
+        while (m_capacity > 0 && m_items.size() >= m_capacity && !m_closed) {
+            m_notFull.wait(&m_mutex);
+        }
+        if (m_closed) {
+            return false;
+        }
+        m_items.enqueue(item);
+        m_notEmpty.wakeOne();
+        return true;
+    }
+
+    // Blocks until an item is available; returns false once the queue is closed and drained.
+    bool pop(T *item)
+    {
+        QMutexLocker locker(&m_mutex);
+        while (m_items.isEmpty() && !m_closed) {
+            m_notEmpty.wait(&m_mutex);
+        }
+        if (m_items.isEmpty()) {
+            return false;
+        }
+        *item = m_items.dequeue();
+        m_notFull.wakeOne();
+        return true;
+    }
+
+    bool tryPop(T *item)
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_items.isEmpty()) {
+            return false;
+        }
+        *item = m_items.dequeue();
+        m_notFull.wakeOne();
+        return true;
+    }
+
+    void close()
+    {
+        QMutexLocker locker(&m_mutex);
+        m_closed = true;
+        m_notEmpty.wakeAll();
+        m_notFull.wakeAll();
+    }
+
+    int size() const
+    {
+        QMutexLocker locker(&m_mutex);
+        return m_items.size();
+    }
+
+private:
+    mutable QMutex m_mutex;
+    QWaitCondition m_notEmpty;
+    QWaitCondition m_notFull;
+    QQueue<T> m_items;
+    int m_capacity;
+    bool m_closed;
+};
+
+#endif // BLOCKINGQUEUE_H
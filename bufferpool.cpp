@@ -0,0 +1,71 @@
+#include "bufferpool.h"
+#include <QMutexLocker>
+#include <cstdlib>
+#include <new>
+
+#ifdef Q_OS_WIN
+#include <malloc.h>
+#endif
+
+BufferPool::BufferPool(int count, qint64 bufferSize)
+    : m_bufferSize((bufferSize + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT)
+    , m_capacity(qMax(1, count))
+{
+}
+
+BufferPool::~BufferPool()
+{
+    for (char *buffer : m_buffers) {
+        freeAligned(buffer);
+    }
+}
+
+char *BufferPool::acquire()
+{
+    QMutexLocker locker(&m_mutex);
+
+    // Buffers are allocated on first use, so a worker that only sees small files
+    // never holds more than one.
+    if (m_free.isEmpty() && m_buffers.size() < m_capacity) {
+        char *buffer = allocateAligned(m_bufferSize);
+        m_buffers.append(buffer);
+        return buffer;
+    }
+
+    while (m_free.isEmpty()) {
+        m_available.wait(&m_mutex);
+    }
+    return m_free.takeLast();
+}
+
+void BufferPool::release(char *buffer)
+{
+    QMutexLocker locker(&m_mutex);
+    m_free.append(buffer);
+    m_available.wakeOne();
+}
+
+char *BufferPool::allocateAligned(qint64 size)
+{
+    void *buffer = nullptr;
+#ifdef Q_OS_WIN
+    buffer = _aligned_malloc(size, ALIGNMENT);
+#else
+    if (posix_memalign(&buffer, ALIGNMENT, size) != 0) {
+        buffer = nullptr;
+    }
+#endif
+    if (!buffer) {
+        throw std::bad_alloc();
+    }
+    return static_cast<char *>(buffer);
+}
+
+void BufferPool::freeAligned(char *buffer)
+{
+#ifdef Q_OS_WIN
+    _aligned_free(buffer);
+#else
+    free(buffer);
+#endif
+}
@@ -0,0 +1,36 @@
+#ifndef BUFFERPOOL_H
+#define BUFFERPOOL_H
+
+#include <QMutex>
+#include <QWaitCondition>
+#include <QVector>
+
+class BufferPool
+{
+public:
+    static constexpr qint64 ALIGNMENT = 4096;
+
+    BufferPool(int count, qint64 bufferSize);
+    ~BufferPool();
+
+    BufferPool(const BufferPool &) = delete;
+    BufferPool &operator=(const BufferPool &) = delete;
+
+    char *acquire();
+    void release(char *buffer);
+
+    qint64 bufferSize() const { return m_bufferSize; }
+
+    static char *allocateAligned(qint64 size);
+    static void freeAligned(char *buffer);
+
+private:
+    qint64 m_bufferSize;
+    int m_capacity;
+    QVector<char *> m_buffers;
+    QVector<char *> m_free;
+    QMutex m_mutex;
+    QWaitCondition m_available;
+};
+
+#endif // BUFFERPOOL_H
@@ -0,0 +1,154 @@
+#include "buffertuner.h"
+#include "bufferpool.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSettings>
+#include <QStandardPaths>
+#include <QStorageInfo>
+#include <algorithm>
+
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#endif
+#ifdef Q_OS_LINUX
+#include <sys/sysmacros.h>
+#endif
+
+namespace {
+
+const qint64 ROTATIONAL_MIN_SIZE = 4 * 1024 * 1024;
+// A reshaped array or a replaced disk can keep its device name and mount point.
+const qint64 CACHE_LIFETIME_SECS = 7 * 24 * 60 * 60;
+// The size that covers this share of the files is enough for the set.
+const double FILE_SIZE_COVERAGE = 0.9;
+
+#ifdef Q_OS_LINUX
+qint64 readSysfsValue(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return 0;
+    }
+    return file.readAll().trimmed().toLongLong();
+}
+
+// Partitions keep their queue limits on the parent disk.
+QString queueDirFor(dev_t device)
+{
+    const QString deviceDir = QString("/sys/dev/block/%1:%2").arg(major(device)).arg(minor(device));
+    const QString queueDir = deviceDir + "/queue";
+    if (QFileInfo::exists(queueDir)) {
+        return queueDir;
+    }
+    const QString parentQueueDir = deviceDir + "/../queue";
+    return QFileInfo::exists(parentQueueDir) ? parentQueueDir : QString();
+}
+#endif
+
+} // namespace
+
+BufferTuner::BufferTuner(qint64 defaultSize)
+    : m_defaultSize(defaultSize)
+    , m_cachePath(defaultCachePath())
+{
+}
+
+bool BufferTuner::isRotational(const QString &path)
+{
+#ifdef Q_OS_LINUX
+    struct stat info;
+    if (::stat(QFile::encodeName(path).constData(), &info) != 0) {
+        return false;
+    }
+    const QString queueDir = queueDirFor(info.st_dev);
+    return !queueDir.isEmpty() && readSysfsValue(queueDir + "/rotational") != 0;
+#else
+    Q_UNUSED(path)
+    return false;
+#endif
+}
+
+QString BufferTuner::defaultCachePath()
+{
+    return QDir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation))
+        .absoluteFilePath("buffer-sizes.ini");
+}
+
+qint64 BufferTuner::bufferSizeFor(const QString &path)
+{
+    const QStorageInfo storage(path);
+    const QString device = QString::fromLocal8Bit(storage.device());
+    const QString group = QString::fromLatin1(
+        QCryptographicHash::hash((device + '\n' + storage.rootPath()).toUtf8(), QCryptographicHash::Sha1)
+            .toHex().left(16));
+
+    QSettings cache(m_cachePath, QSettings::IniFormat);
+    const qint64 now = QDateTime::currentSecsSinceEpoch();
+    const qint64 cached = cache.value(group + "/bufferSize", 0).toLongLong();
+    const qint64 probedAt = cache.value(group + "/probedAt", 0).toLongLong();
+    if (cached > 0 && now - probedAt < CACHE_LIFETIME_SECS
+        && cache.value(group + "/defaultSize", 0).toLongLong() == m_defaultSize) {
+        return cached;
+    }
+
+    const qint64 size = probe(path);
+
+    cache.setValue(group + "/device", device);
+    cache.setValue(group + "/mountPoint", storage.rootPath());
+    cache.setValue(group + "/bufferSize", size);
+    cache.setValue(group + "/defaultSize", m_defaultSize);
+    cache.setValue(group + "/probedAt", now);
+    return size;
+}
+
+qint64 BufferTuner::fitToFileSizes(qint64 size, QVector<qint64> fileSizes)
+{
+    if (fileSizes.isEmpty()) {
+        return size;
+    }
+
+    const int index = qMin(int(fileSizes.size() * FILE_SIZE_COVERAGE), int(fileSizes.size()) - 1);
+    std::nth_element(fileSizes.begin(), fileSizes.begin() + index, fileSizes.end());
+    const qint64 needed = qMax(MIN_BUFFER_SIZE, fileSizes.at(index));
+    if (needed >= size) {
+        return size;
+    }
+    return (needed + BufferPool::ALIGNMENT - 1) / BufferPool::ALIGNMENT * BufferPool::ALIGNMENT;
+}
+
+qint64 BufferTuner::probe(const QString &path) const
+{
+    qint64 size = m_defaultSize;
+
+#ifdef Q_OS_UNIX
+    struct stat info;
+    if (::stat(QFile::encodeName(path).constData(), &info) != 0) {
+        return m_defaultSize;
+    }
+    size = qMax<qint64>(size, info.st_blksize);
+
+#ifdef Q_OS_LINUX
+    const QString queueDir = queueDirFor(info.st_dev);
+    if (!queueDir.isEmpty()) {
+        // md, LVM and most RAID controllers report the full stripe width here; two
+        // stripes per request keep every member disk busy.
+        const qint64 optimalSize = readSysfsValue(queueDir + "/optimal_io_size");
+        if (optimalSize > 0) {
+            size = qMax(size, 2 * optimalSize);
+        }
+
+        if (readSysfsValue(queueDir + "/rotational") != 0) {
+            size = qMax(size, ROTATIONAL_MIN_SIZE);
+        }
+    }
+#endif
+#else
+    Q_UNUSED(path)
+#endif
+
+    size = qBound(MIN_BUFFER_SIZE, size, MAX_BUFFER_SIZE);
+    return (size + BufferPool::ALIGNMENT - 1) / BufferPool::ALIGNMENT * BufferPool::ALIGNMENT;
+}
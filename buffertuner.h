@@ -0,0 +1,34 @@
+#ifndef BUFFERTUNER_H
+#define BUFFERTUNER_H
+
+#include <QString>
+#include <QVector>
+
+// Picks a transfer size for the storage behind a path from the device's I/O hints
+// (st_blksize, and on Linux the block queue limits in sysfs). Results are cached
+// per device and mount point between runs, and probed again once they are a week old.
+class BufferTuner
+{
+public:
+    static constexpr qint64 MIN_BUFFER_SIZE = 64 * 1024;
+    static constexpr qint64 MAX_BUFFER_SIZE = 16 * 1024 * 1024;
+
+    explicit BufferTuner(qint64 defaultSize);
+
+    qint64 bufferSizeFor(const QString &path);
+    // Shrinks a device's size to what most of the given files need, so a set of small
+    // files doesn't hold buffers far larger than any of them.
+    static qint64 fitToFileSizes(qint64 size, QVector<qint64> fileSizes);
+
+    // True for spinning disks, where concurrent streams cost seeks. Linux only.
+    static bool isRotational(const QString &path);
+    static QString defaultCachePath();
+
+private:
+    qint64 probe(const QString &path) const;
+
+    qint64 m_defaultSize;
+    QString m_cachePath;
+};
+
+#endif // BUFFERTUNER_H
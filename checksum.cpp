@@ -0,0 +1,361 @@
+#include "checksum.h"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CHECKSUM_X86
+#include <nmmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#elif defined(__ARM_FEATURE_CRC32)
+#define CHECKSUM_ARM_CRC
+#include <arm_acle.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define CHECKSUM_TARGET(isa) __attribute__((target(isa)))
+#else
+#define CHECKSUM_TARGET(isa)
+#endif
+
+namespace {
+
+const quint32 CRC32C_POLYNOMIAL = 0x82f63b78;
+
+const quint64 XXH_PRIME1 = 11400714785074694791ULL;
+const quint64 XXH_PRIME2 = 14029467366897019727ULL;
+const quint64 XXH_PRIME3 = 1609587929392839161ULL;
+const quint64 XXH_PRIME4 = 9650029242287828579ULL;
+const quint64 XXH_PRIME5 = 2870177450012600261ULL;
+
+struct Crc32cTable
+{
+    quint32 entries[8][256];
+
+    Crc32cTable()
+    {
+        for (quint32 i = 0; i < 256; ++i) {
+            quint32 crc = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc >> 1) ^ (CRC32C_POLYNOMIAL & (0u - (crc & 1)));
+            }
+            entries[0][i] = crc;
+        }
+        for (int slice = 1; slice < 8; ++slice) {
+            for (quint32 i = 0; i < 256; ++i) {
+                const quint32 previous = entries[slice - 1][i];
+                entries[slice][i] = (previous >> 8) ^ entries[0][previous & 0xff];
+            }
+        }
+    }
+};
+
+// Slicing-by-8: eight table lookups per 8 input bytes.
+quint32 crc32cSoftware(quint32 crc, const unsigned char *data, qint64 size)
+{
+    static const Crc32cTable table;
+
+    while (size >= 8) {
+        quint32 low;
+        quint32 high;
+        std::memcpy(&low, data, 4);
+        std::memcpy(&high, data + 4, 4);
+        low ^= crc;
+        crc = table.entries[7][low & 0xff] ^ table.entries[6][(low >> 8) & 0xff]
+            ^ table.entries[5][(low >> 16) & 0xff] ^ table.entries[4][low >> 24]
+            ^ table.entries[3][high & 0xff] ^ table.entries[2][(high >> 8) & 0xff]
+            ^ table.entries[1][(high >> 16) & 0xff] ^ table.entries[0][high >> 24];
+        data += 8;
+        size -= 8;
+    }
+    while (size-- > 0) {
+        crc = (crc >> 8) ^ table.entries[0][(crc ^ *data++) & 0xff];
+    }
+    return crc;
+}
+
+#if defined(CHECKSUM_X86)
+CHECKSUM_TARGET("sse4.2")
+quint32 crc32cHardware(quint32 crc, const unsigned char *data, qint64 size)
+{
+#if defined(__x86_64__) || defined(_M_X64)
+    quint64 crc64 = crc;
+    while (size >= 8) {
+        quint64 word;
+        std::memcpy(&word, data, 8);
+        crc64 = _mm_crc32_u64(crc64, word);
+        data += 8;
+        size -= 8;
+    }
+    crc = quint32(crc64);
+#endif
+    while (size >= 4) {
+        quint32 word;
+        std::memcpy(&word, data, 4);
+        crc = _mm_crc32_u32(crc, word);
+        data += 4;
+        size -= 4;
+    }
+    while (size-- > 0) {
+        crc = _mm_crc32_u8(crc, *data++);
+    }
+    return crc;
+}
+
+bool cpuHasCrc32c()
+{
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse4.2");
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 20)) != 0;
+#else
+    return false;
+#endif
+}
+#elif defined(CHECKSUM_ARM_CRC)
+quint32 crc32cHardware(quint32 crc, const unsigned char *data, qint64 size)
+{
+    while (size >= 8) {
+        quint64 word;
+        std::memcpy(&word, data, 8);
+        crc = __crc32cd(crc, word);
+        data += 8;
+        size -= 8;
+    }
+    while (size-- > 0) {
+        crc = __crc32cb(crc, *data++);
+    }
+    return crc;
+}
+
+bool cpuHasCrc32c()
+{
+    return true;
+}
+#endif
+
+typedef quint32 (*Crc32cFunction)(quint32 crc, const unsigned char *data, qint64 size);
+
+Crc32cFunction crc32cFunction()
+{
+#if defined(CHECKSUM_X86) || defined(CHECKSUM_ARM_CRC)
+    static const Crc32cFunction function = cpuHasCrc32c() ? crc32cHardware : crc32cSoftware;
+#else
+    static const Crc32cFunction function = crc32cSoftware;
+#endif
+    return function;
+}
+
+inline quint64 rotateLeft(quint64 value, int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+inline quint64 readWord(const unsigned char *data)
+{
+    quint64 value = 0;
+    for (int i = 7; i >= 0; --i) {
+        value = (value << 8) | data[i];
+    }
+    return value;
+}
+
+inline quint64 xxhRound(quint64 accumulator, quint64 input)
+{
+    accumulator += input * XXH_PRIME2;
+    accumulator = rotateLeft(accumulator, 31);
+    return accumulator * XXH_PRIME1;
+}
+
+inline quint64 xxhMerge(quint64 hash, quint64 accumulator)
+{
+    hash ^= xxhRound(0, accumulator);
+    return hash * XXH_PRIME1 + XXH_PRIME4;
+}
+
+} // namespace
+
+Checksum::Checksum(Algorithm algorithm)
+    : m_algorithm(algorithm)
+{
+    reset();
+}
+
+void Checksum::reset()
+{
+    m_crc = 0xffffffffu;
+    m_accumulators[0] = XXH_PRIME1 + XXH_PRIME2;
+    m_accumulators[1] = XXH_PRIME2;
+    m_accumulators[2] = 0;
+    m_accumulators[3] = 0 - XXH_PRIME1;
+    m_pendingSize = 0;
+    m_totalSize = 0;
+}
+
+void Checksum::update(const char *data, qint64 size)
+{
+    const unsigned char *bytes = reinterpret_cast<const unsigned char *>(data);
+
+    switch (m_algorithm) {
+    case Crc32c:
+        m_crc = crc32cFunction()(m_crc, bytes, size);
+        break;
+    case XxHash64: {
+        m_totalSize += quint64(size);
+
+        if (m_pendingSize + size < 32) {
+            std::memcpy(m_pending + m_pendingSize, bytes, size);
+            m_pendingSize += int(size);
+            return;
+        }
+
+        if (m_pendingSize > 0) {
+            const int fill = 32 - m_pendingSize;
+            std::memcpy(m_pending + m_pendingSize, bytes, fill);
+            for (int lane = 0; lane < 4; ++lane) {
+                m_accumulators[lane] = xxhRound(m_accumulators[lane], readWord(m_pending + 8 * lane));
+            }
+            bytes += fill;
+            size -= fill;
+            m_pendingSize = 0;
+        }
+
+        quint64 v1 = m_accumulators[0];
+        quint64 v2 = m_accumulators[1];
+        quint64 v3 = m_accumulators[2];
+        quint64 v4 = m_accumulators[3];
+        while (size >= 32) {
+            v1 = xxhRound(v1, readWord(bytes));
+            v2 = xxhRound(v2, readWord(bytes + 8));
+            v3 = xxhRound(v3, readWord(bytes + 16));
+            v4 = xxhRound(v4, readWord(bytes + 24));
+            bytes += 32;
+            size -= 32;
+        }
+        m_accumulators[0] = v1;
+        m_accumulators[1] = v2;
+        m_accumulators[2] = v3;
+        m_accumulators[3] = v4;
+
+        std::memcpy(m_pending, bytes, size);
+        m_pendingSize = int(size);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+quint64 Checksum::value() const
+{
+    switch (m_algorithm) {
+    case Crc32c:
+        return ~m_crc;
+    case XxHash64: {
+        quint64 hash;
+        if (m_totalSize >= 32) {
+            hash = rotateLeft(m_accumulators[0], 1) + rotateLeft(m_accumulators[1], 7)
+                + rotateLeft(m_accumulators[2], 12) + rotateLeft(m_accumulators[3], 18);
+            for (quint64 accumulator : m_accumulators) {
+                hash = xxhMerge(hash, accumulator);
+            }
+        } else {
+            hash = m_accumulators[2] + XXH_PRIME5;
+        }
+        hash += m_totalSize;
+
+        const unsigned char *p = m_pending;
+        const unsigned char *end = m_pending + m_pendingSize;
+        for (; p + 8 <= end; p += 8) {
+            hash ^= xxhRound(0, readWord(p));
+            hash = rotateLeft(hash, 27) * XXH_PRIME1 + XXH_PRIME4;
+        }
+        if (p + 4 <= end) {
+            const quint64 word = quint64(p[0]) | quint64(p[1]) << 8 | quint64(p[2]) << 16 | quint64(p[3]) << 24;
+            hash ^= word * XXH_PRIME1;
+            hash = rotateLeft(hash, 23) * XXH_PRIME2 + XXH_PRIME3;
+            p += 4;
+        }
+        for (; p < end; ++p) {
+            hash ^= *p * XXH_PRIME5;
+            hash = rotateLeft(hash, 11) * XXH_PRIME1;
+        }
+
+        hash ^= hash >> 33;
+        hash *= XXH_PRIME2;
+        hash ^= hash >> 29;
+        hash *= XXH_PRIME3;
+        hash ^= hash >> 32;
+        return hash;
+    }
+    default:
+        return 0;
+    }
+}
+
+QString Checksum::toHex() const
+{
+    switch (m_algorithm) {
+    case Crc32c:
+        return QString::number(value(), 16).rightJustified(8, '0');
+    case XxHash64:
+        return QString::number(value(), 16).rightJustified(16, '0');
+    default:
+        return QString();
+    }
+}
+
+const char *Checksum::algorithmName(Algorithm algorithm)
+{
+    switch (algorithm) {
+    case Crc32c:
+        return "crc32c";
+    case XxHash64:
+        return "xxhash64";
+    default:
+        return "none";
+    }
+}
+
+Checksum::Algorithm Checksum::algorithmFromName(const QString &name, bool *ok)
+{
+    const Algorithm algorithms[] = { NoChecksum, Crc32c, XxHash64 };
+    for (Algorithm algorithm : algorithms) {
+        if (name == algorithmName(algorithm)) {
+            if (ok) {
+                *ok = true;
+            }
+            return algorithm;
+        }
+    }
+
+    if (ok) {
+        *ok = false;
+    }
+    return NoChecksum;
+}
+
+bool Checksum::hasHardwareCrc32c()
+{
+#if defined(CHECKSUM_X86) || defined(CHECKSUM_ARM_CRC)
+    return cpuHasCrc32c();
+#else
+    return false;
+#endif
+}
+
+quint32 Checksum::crc32c(const char *data, qint64 size, bool hardware)
+{
+    const unsigned char *bytes = reinterpret_cast<const unsigned char *>(data);
+#if defined(CHECKSUM_X86) || defined(CHECKSUM_ARM_CRC)
+    if (hardware && cpuHasCrc32c()) {
+        return ~crc32cHardware(0xffffffffu, bytes, size);
+    }
+#else
+    Q_UNUSED(hardware)
+#endif
+    return ~crc32cSoftware(0xffffffffu, bytes, size);
+}
@@ -0,0 +1,44 @@
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <QString>
+
+// Streaming CRC32C or xxHash64, fed chunk by chunk from the processing loops. CRC32C
+// uses the SSE4.2 or ARMv8 CRC instructions when the CPU has them.
+class Checksum
+{
+public:
+    enum Algorithm {
+        NoChecksum,
+        Crc32c,
+        XxHash64
+    };
+
+    explicit Checksum(Algorithm algorithm = NoChecksum);
+
+    Algorithm algorithm() const { return m_algorithm; }
+    bool isEnabled() const { return m_algorithm != NoChecksum; }
+
+    void reset();
+    void update(const char *data, qint64 size);
+    quint64 value() const;
+    QString toHex() const;
+
+    static const char *algorithmName(Algorithm algorithm);
+    static Algorithm algorithmFromName(const QString &name, bool *ok = nullptr);
+    static bool hasHardwareCrc32c();
+    // One-shot CRC32C through the CRC instruction or the slicing-by-8 table, so the two
+    // can be checked against each other; without the instruction both use the table.
+    static quint32 crc32c(const char *data, qint64 size, bool hardware);
+
+private:
+    Algorithm m_algorithm;
+    quint32 m_crc;
+
+    quint64 m_accumulators[4];
+    unsigned char m_pending[32];
+    int m_pendingSize;
+    quint64 m_totalSize;
+};
+
+#endif // CHECKSUM_H
@@ -0,0 +1,186 @@
+#include <QByteArray>
+#include <QRandomGenerator>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "checksum.h"
+
+// Known answers for CRC32C (RFC 3720, appendix B.4, and the usual "123456789" check
+// value) and xxHash64 with seed 0, the streaming interface fed in arbitrary pieces,
+// and the CRC instruction against the slicing-by-8 table on misaligned buffers.
+namespace {
+
+const int ROUNDS = 2000;
+const int MAX_SIZE = 4096 + 67;
+const int MAX_MISALIGNMENT = 16;
+
+struct KnownAnswer
+{
+    const char *name;
+    QByteArray data;
+    quint64 value;
+};
+
+QByteArray repeated(int size, char byte)
+{
+    return QByteArray(size, byte);
+}
+
+QByteArray ascending(int size)
+{
+    QByteArray bytes(size, Qt::Uninitialized);
+    for (int i = 0; i < size; ++i) {
+        bytes[i] = char(i);
+    }
+    return bytes;
+}
+
+QByteArray descending(int size)
+{
+    QByteArray bytes(size, Qt::Uninitialized);
+    for (int i = 0; i < size; ++i) {
+        bytes[i] = char(size - 1 - i);
+    }
+    return bytes;
+}
+
+QByteArray randomBytes(QRandomGenerator &random, int size)
+{
+    QByteArray bytes(size, Qt::Uninitialized);
+    for (int i = 0; i < size; ++i) {
+        bytes[i] = char(random.bounded(256));
+    }
+    return bytes;
+}
+
+quint64 hashWhole(Checksum::Algorithm algorithm, const QByteArray &data)
+{
+    Checksum checksum(algorithm);
+    checksum.update(data.constData(), data.size());
+    return checksum.value();
+}
+
+// Splits the input at random points, including empty pieces.
+quint64 hashInPieces(QRandomGenerator &random, Checksum::Algorithm algorithm, const QByteArray &data)
+{
+    Checksum checksum(algorithm);
+    int offset = 0;
+    while (offset < data.size()) {
+        const int length = random.bounded(qMin(int(data.size()) - offset, 100) + 1);
+        checksum.update(data.constData() + offset, length);
+        offset += length;
+    }
+    return checksum.value();
+}
+
+bool checkKnownAnswers(Checksum::Algorithm algorithm, const std::vector<KnownAnswer> &answers)
+{
+    bool ok = true;
+    for (const KnownAnswer &answer : answers) {
+        const quint64 value = hashWhole(algorithm, answer.data);
+        if (value != answer.value) {
+            std::fprintf(stderr, "%s(%s) = %016llx, expected %016llx\n", Checksum::algorithmName(algorithm),
+                         answer.name, static_cast<unsigned long long>(value),
+                         static_cast<unsigned long long>(answer.value));
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+bool checkStreaming(QRandomGenerator &random, Checksum::Algorithm algorithm)
+{
+    for (int round = 0; round < ROUNDS; ++round) {
+        const QByteArray data = randomBytes(random, random.bounded(MAX_SIZE + 1));
+        const quint64 whole = hashWhole(algorithm, data);
+        const quint64 pieces = hashInPieces(random, algorithm, data);
+        if (whole != pieces) {
+            std::fprintf(stderr, "%s: %d bytes in pieces give %016llx, at once %016llx\n",
+                         Checksum::algorithmName(algorithm), int(data.size()),
+                         static_cast<unsigned long long>(pieces), static_cast<unsigned long long>(whole));
+            return false;
+        }
+
+        Checksum checksum(algorithm);
+        checksum.update(data.constData(), data.size());
+        checksum.reset();
+        checksum.update(data.constData(), data.size());
+        if (checksum.value() != whole) {
+            std::fprintf(stderr, "%s: reset does not start over\n", Checksum::algorithmName(algorithm));
+            return false;
+        }
+    }
+    return true;
+}
+
+bool checkCrcPathsAgree(QRandomGenerator &random)
+{
+    std::vector<char> buffer(MAX_SIZE + MAX_MISALIGNMENT);
+    for (int round = 0; round < ROUNDS; ++round) {
+        const int size = random.bounded(MAX_SIZE + 1);
+        const int shift = random.bounded(MAX_MISALIGNMENT);
+        const QByteArray data = randomBytes(random, size);
+        std::memcpy(buffer.data() + shift, data.constData(), size);
+
+        const quint32 hardware = Checksum::crc32c(buffer.data() + shift, size, true);
+        const quint32 software = Checksum::crc32c(buffer.data() + shift, size, false);
+        if (hardware != software) {
+            std::fprintf(stderr, "crc32c of %d bytes at +%d: instruction %08x, table %08x\n", size, shift,
+                         hardware, software);
+            return false;
+        }
+        if (software != quint32(hashWhole(Checksum::Crc32c, data))) {
+            std::fprintf(stderr, "crc32c of %d bytes: one-shot and streaming differ\n", size);
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main()
+{
+    QRandomGenerator random(0xc5c5);
+    int failures = 0;
+
+    const std::vector<KnownAnswer> crcAnswers = {
+        { "\"\"", QByteArray(), 0x00000000 },
+        { "\"123456789\"", QByteArray("123456789"), 0xe3069283 },
+        { "32 x 00", repeated(32, '\x00'), 0x8a9136aa },
+        { "32 x ff", repeated(32, '\xff'), 0x62a8ab43 },
+        { "00..1f", ascending(32), 0x46dd794e },
+        { "1f..00", descending(32), 0x113fdb5c },
+    };
+    const std::vector<KnownAnswer> xxhAnswers = {
+        { "\"\"", QByteArray(), Q_UINT64_C(0xef46db3751d8e999) },
+        { "\"a\"", QByteArray("a"), Q_UINT64_C(0xd24ec4f1a98c6e5b) },
+        { "\"abc\"", QByteArray("abc"), Q_UINT64_C(0x44bc2cf5ad770999) },
+        { "\"Nobody inspects the spammish repetition\"", QByteArray("Nobody inspects the spammish repetition"),
+          Q_UINT64_C(0xfbcea83c8a378bf1) },
+    };
+
+    if (!checkKnownAnswers(Checksum::Crc32c, crcAnswers)) {
+        ++failures;
+    }
+    if (!checkKnownAnswers(Checksum::XxHash64, xxhAnswers)) {
+        ++failures;
+    }
+    if (!checkStreaming(random, Checksum::Crc32c)) {
+        ++failures;
+    }
+    if (!checkStreaming(random, Checksum::XxHash64)) {
+        ++failures;
+    }
+
+    if (Checksum::hasHardwareCrc32c()) {
+        if (!checkCrcPathsAgree(random)) {
+            ++failures;
+        }
+    } else {
+        std::printf("crc32c: no CRC instruction on this CPU, table only\n");
+    }
+
+    std::printf("%d checks failed\n", failures);
+    return failures == 0 ? 0 : 1;
+}
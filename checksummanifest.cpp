@@ -0,0 +1,127 @@
+#include "checksummanifest.h"
+#include <QDir>
+#include <QFile>
+#include <QMutexLocker>
+#include <QSaveFile>
+
+namespace {
+
+const char MANIFEST_FILE_NAME[] = "xor-manifest.txt";
+const char MANIFEST_HEADER[] = "# xor-manifest 1 ";
+const char NO_CHECKSUM[] = "-";
+
+} // namespace
+
+ChecksumManifest::ChecksumManifest(const QString &outputPath, Checksum::Algorithm algorithm)
+    : m_rootPath(QDir(outputPath).absolutePath())
+    , m_algorithm(algorithm)
+{
+}
+
+QString ChecksumManifest::filePath(const QString &outputPath)
+{
+    return QDir(outputPath).absoluteFilePath(MANIFEST_FILE_NAME);
+}
+
+bool ChecksumManifest::load()
+{
+    QMutexLocker locker(&m_mutex);
+    m_entries.clear();
+
+    QFile file(filePath(m_rootPath));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return !file.exists();
+    }
+
+    const QString header = QString::fromUtf8(file.readLine()).trimmed();
+    if (!header.startsWith(QString(MANIFEST_HEADER).trimmed())) {
+        return false;
+    }
+
+    bool known = false;
+    const Checksum::Algorithm algorithm =
+        Checksum::algorithmFromName(header.mid(int(qstrlen(MANIFEST_HEADER))), &known);
+    if (!known || algorithm == Checksum::NoChecksum) {
+        return false;
+    }
+    if (m_algorithm == Checksum::NoChecksum) {
+        m_algorithm = algorithm;
+    } else if (algorithm != m_algorithm) {
+        return true;
+    }
+
+    while (!file.atEnd()) {
+        QString line = QString::fromUtf8(file.readLine());
+        if (line.endsWith('\n')) {
+            line.chop(1);
+        }
+        if (line.isEmpty()) {
+            continue;
+        }
+
+        // The path is the rest of the line, so it may contain spaces.
+        const QStringList fields = line.split(' ');
+        if (fields.size() < 4) {
+            m_entries.clear();
+            return false;
+        }
+
+        bool ok = false;
+        Entry entry;
+        entry.inputChecksum = fields.at(0) == NO_CHECKSUM ? QString() : fields.at(0);
+        entry.outputChecksum = fields.at(1);
+        entry.size = fields.at(2).toLongLong(&ok);
+        if (!ok) {
+            m_entries.clear();
+            return false;
+        }
+
+        const int pathStart = int(fields.at(0).size() + fields.at(1).size() + fields.at(2).size()) + 3;
+        m_entries.insert(line.mid(pathStart), entry);
+    }
+
+    return true;
+}
+
+bool ChecksumManifest::save()
+{
+    QMutexLocker locker(&m_mutex);
+
+    QSaveFile file(filePath(m_rootPath));
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    QByteArray data = QByteArray(MANIFEST_HEADER) + Checksum::algorithmName(m_algorithm) + '\n';
+    for (auto it = m_entries.constBegin(); it != m_entries.constEnd(); ++it) {
+        const Entry &entry = it.value();
+        data += (entry.inputChecksum.isEmpty() ? QString(NO_CHECKSUM) : entry.inputChecksum).toLatin1();
+        data += ' ' + entry.outputChecksum.toLatin1();
+        data += ' ' + QByteArray::number(entry.size);
+        data += ' ' + it.key().toUtf8() + '\n';
+    }
+
+    return file.write(data) == data.size() && file.commit();
+}
+
+void ChecksumManifest::insert(const QString &filePath, const Entry &entry)
+{
+    const QString relativePath = QDir(m_rootPath).relativeFilePath(filePath);
+
+    QMutexLocker locker(&m_mutex);
+    m_entries.insert(relativePath, entry);
+}
+
+void ChecksumManifest::remove(const QString &filePath)
+{
+    const QString relativePath = QDir(m_rootPath).relativeFilePath(filePath);
+
+    QMutexLocker locker(&m_mutex);
+    m_entries.remove(relativePath);
+}
+
+QMap<QString, ChecksumManifest::Entry> ChecksumManifest::entries() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_entries;
+}
@@ -0,0 +1,49 @@
+#ifndef CHECKSUMMANIFEST_H
+#define CHECKSUMMANIFEST_H
+
+#include <QMap>
+#include <QMutex>
+#include <QString>
+#include "checksum.h"
+
+// Checksums of the outputs in a tree, kept as a text file at the output root:
+//
+//     # xor-manifest 1 crc32c
+//     <input checksum or -> <output checksum> <size> <path relative to the root>
+//
+// Entries from earlier runs are kept and replaced when a file is written again.
+class ChecksumManifest
+{
+public:
+    struct Entry
+    {
+        QString inputChecksum;
+        QString outputChecksum;
+        qint64 size = 0;
+    };
+
+    ChecksumManifest(const QString &outputPath, Checksum::Algorithm algorithm);
+
+    static QString filePath(const QString &outputPath);
+
+    // Reads the manifest; with a different algorithm on disk the old entries are dropped,
+    // unless the algorithm was left as NoChecksum, which adopts the one on disk.
+    bool load();
+    bool save();
+
+    Checksum::Algorithm algorithm() const { return m_algorithm; }
+    QString rootPath() const { return m_rootPath; }
+
+    void insert(const QString &filePath, const Entry &entry);
+    void remove(const QString &filePath);
+    QMap<QString, Entry> entries() const;
+
+private:
+    QString m_rootPath;
+    Checksum::Algorithm m_algorithm;
+
+    mutable QMutex m_mutex;
+    QMap<QString, Entry> m_entries;
+};
+
+#endif // CHECKSUMMANIFEST_H
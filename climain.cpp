@@ -0,0 +1,490 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QScopedPointer>
+#include <QSet>
+#include <QSettings>
+#include <QTimer>
+#include <QDir>
+#include <csignal>
+#include <cstdio>
+#include "fileprocessor.h"
+#include "directorywatcher.h"
+#include "jobscheduler.h"
+
+namespace {
+
+volatile std::sig_atomic_t s_terminateRequested = 0;
+
+void requestTerminate(int)
+{
+    s_terminateRequested = 1;
+}
+
+// One compact JSON object per line so results can be piped into other tools.
+void printEvent(const QJsonObject &event)
+{
+    const QByteArray line = QJsonDocument(event).toJson(QJsonDocument::Compact);
+    std::fwrite(line.constData(), 1, line.size(), stdout);
+    std::fputc('\n', stdout);
+    std::fflush(stdout);
+}
+
+// Command line flags take precedence over keys of the same name in the config file.
+QString optionValue(const QCommandLineParser &parser, const QSettings *config, const QString &name,
+                    const QString &defaultValue = QString())
+{
+    if (parser.isSet(name)) {
+        return parser.value(name);
+    }
+    if (config && config->contains(name)) {
+        return config->value(name).toString();
+    }
+    return defaultValue;
+}
+
+bool optionFlag(const QCommandLineParser &parser, const QSettings *config, const QString &name)
+{
+    if (parser.isSet(name)) {
+        return true;
+    }
+    return config && config->value(name, false).toBool();
+}
+
+bool parseSettings(const QCommandLineParser &parser, const QSettings *config,
+                   FileProcessorSettings *settings, QString *error)
+{
+    settings->inputPath = optionValue(parser, config, "input");
+    settings->outputPath = optionValue(parser, config, "output");
+    settings->fileMask = optionValue(parser, config, "mask", "*");
+    settings->recursive = optionFlag(parser, config, "recursive");
+    settings->deleteInputFiles = optionFlag(parser, config, "delete");
+    settings->overwriteOutput = !optionFlag(parser, config, "rename");
+    settings->transformInPlace = optionFlag(parser, config, "in-place");
+    settings->outputFormat = optionFlag(parser, config, "pack") ? FileProcessorSettings::PackedSegments
+                                                                : FileProcessorSettings::SeparateFiles;
+    settings->skipUnchanged = optionFlag(parser, config, "skip-unchanged");
+    settings->indexContentHash = optionFlag(parser, config, "content-hash");
+    settings->indexPath = optionValue(parser, config, "index");
+    settings->resumable = optionFlag(parser, config, "resume");
+    settings->checksumInput = optionFlag(parser, config, "checksum-input");
+    settings->verifyManifest = optionFlag(parser, config, "verify");
+    settings->metricsPath = optionValue(parser, config, "metrics-file");
+
+    if (!settings->verifyManifest && (settings->inputPath.isEmpty() || !QDir(settings->inputPath).exists())) {
+        *error = "Папка с входными файлами не существует";
+        return false;
+    }
+    if (settings->outputPath.isEmpty()) {
+        *error = "Укажите путь для сохранения результатов";
+        return false;
+    }
+
+    // Verification works without a key; it then checks only the output checksums.
+    const QString keyFile = optionValue(parser, config, "key-file");
+    const QString keyText = optionValue(parser, config, "key");
+    if (!settings->verifyManifest || !keyFile.isEmpty() || !keyText.isEmpty()) {
+        settings->key = keyFile.isEmpty() ? XorKey::fromHex(keyText, error) : XorKey::fromFile(keyFile, error);
+        if (settings->key.isNull()) {
+            return false;
+        }
+    }
+
+    bool ok = false;
+
+    const QString checksum = optionValue(parser, config, "checksum", "none");
+    settings->checksumAlgorithm = Checksum::algorithmFromName(checksum, &ok);
+    if (!ok) {
+        *error = "Неизвестный алгоритм контрольных сумм: " + checksum;
+        return false;
+    }
+
+    settings->workerCount = optionValue(parser, config, "workers", "0").toInt(&ok);
+    if (!ok || settings->workerCount < 0) {
+        *error = "Некорректное число потоков";
+        return false;
+    }
+
+    const QString engine = optionValue(parser, config, "engine", "buffered");
+    if (engine == "buffered") {
+        settings->ioEngine = FileProcessorSettings::BufferedIo;
+    } else if (engine == "mmap") {
+        settings->ioEngine = FileProcessorSettings::MemoryMappedIo;
+    } else if (engine == "uring") {
+        settings->ioEngine = FileProcessorSettings::UringIo;
+    } else {
+        *error = "Неизвестный режим ввода-вывода: " + engine;
+        return false;
+    }
+
+    const QString cache = optionValue(parser, config, "cache", "page");
+    if (cache == "page") {
+        settings->cachePolicy = FileProcessorSettings::PageCache;
+    } else if (cache == "drop") {
+        settings->cachePolicy = FileProcessorSettings::DropCache;
+    } else if (cache == "direct") {
+        settings->cachePolicy = FileProcessorSettings::DirectIo;
+    } else {
+        *error = "Неизвестная политика кэша: " + cache;
+        return false;
+    }
+
+    const QString durability = optionValue(parser, config, "durability", "none");
+    if (durability == "none") {
+        settings->durability = FileProcessorSettings::NoSync;
+    } else if (durability == "file") {
+        settings->durability = FileProcessorSettings::SyncEachFile;
+    } else if (durability == "group") {
+        settings->durability = FileProcessorSettings::GroupCommit;
+    } else {
+        *error = "Неизвестная политика сохранения: " + durability;
+        return false;
+    }
+
+    settings->bufferSize = optionValue(parser, config, "buffer-size", "0").toLongLong(&ok);
+    if (!ok || settings->bufferSize < 0) {
+        *error = "Некорректный размер буфера";
+        return false;
+    }
+
+    settings->packSegmentSize = optionValue(parser, config, "segment-size",
+                                            QString::number(PackWriter::DEFAULT_SEGMENT_SIZE)).toLongLong(&ok);
+    if (!ok || settings->packSegmentSize <= 0) {
+        *error = "Некорректный размер сегмента";
+        return false;
+    }
+
+    settings->queueDepth = optionValue(parser, config, "queue-depth", "4").toInt(&ok);
+    if (!ok || settings->queueDepth < 1) {
+        *error = "Некорректная глубина очереди";
+        return false;
+    }
+
+    const QString metricsFormat = optionValue(parser, config, "metrics-format", "json");
+    if (metricsFormat == "json") {
+        settings->metricsFormat = FileProcessorSettings::JsonMetrics;
+    } else if (metricsFormat == "prometheus") {
+        settings->metricsFormat = FileProcessorSettings::PrometheusMetrics;
+    } else {
+        *error = "Неизвестный формат метрик: " + metricsFormat;
+        return false;
+    }
+
+    settings->metricsIntervalMs = optionValue(parser, config, "metrics-interval", "1000").toInt(&ok);
+    if (!ok || settings->metricsIntervalMs <= 0) {
+        *error = "Некорректный интервал метрик";
+        return false;
+    }
+
+    return true;
+}
+
+// Each group of the jobs file is one job, with the same keys as a config file plus
+// "priority". Flags given on the command line apply to every job.
+int runJobs(QCoreApplication &app, const QCommandLineParser &parser)
+{
+    QSettings jobsFile(parser.value("jobs"), QSettings::IniFormat);
+    if (jobsFile.status() != QSettings::NoError) {
+        printEvent({ { "event", "error" }, { "message", "Не удалось прочитать файл заданий: " + parser.value("jobs") } });
+        return 2;
+    }
+
+    JobScheduler scheduler;
+
+    const QStringList groups = jobsFile.childGroups();
+    if (groups.isEmpty()) {
+        printEvent({ { "event", "error" }, { "message", "В файле заданий нет ни одного задания" } });
+        return 2;
+    }
+    for (const QString &group : groups) {
+        JobProfile job;
+        job.name = group;
+
+        QString error;
+        bool ok = true;
+        jobsFile.beginGroup(group);
+        const bool parsed = parseSettings(parser, &jobsFile, &job.settings, &error);
+        job.priority = jobsFile.value("priority", 0).toInt(&ok);
+        jobsFile.endGroup();
+
+        if (!parsed) {
+            printEvent({ { "event", "error" }, { "message", "[" + group + "] " + error } });
+            return 2;
+        }
+        if (!ok) {
+            printEvent({ { "event", "error" }, { "message", "[" + group + "] Некорректный приоритет" } });
+            return 2;
+        }
+        scheduler.addJob(job);
+    }
+
+    bool ok = true;
+    scheduler.setWorkerCount(optionValue(parser, nullptr, "workers", "0").toInt(&ok));
+    const int deviceConcurrency = optionValue(parser, nullptr, "device-concurrency", "0").toInt(&ok);
+    if (!ok || deviceConcurrency < 0) {
+        printEvent({ { "event", "error" }, { "message", "Некорректное число файлов на устройство" } });
+        return 2;
+    }
+    scheduler.setDeviceConcurrency(deviceConcurrency);
+
+    const QString order = optionValue(parser, nullptr, "order", "largest");
+    if (order == "largest") {
+        scheduler.setFileOrder(JobScheduler::LargestFirst);
+    } else if (order == "smallest") {
+        scheduler.setFileOrder(JobScheduler::SmallestFirst);
+    } else if (order == "discovery") {
+        scheduler.setFileOrder(JobScheduler::DiscoveryOrder);
+    } else {
+        printEvent({ { "event", "error" }, { "message", "Неизвестный порядок файлов: " + order } });
+        return 2;
+    }
+
+    QElapsedTimer runTimer;
+    QTimer terminateTimer;
+    int exitCode = 0;
+    int lastProgress = -1;
+
+    QObject::connect(&scheduler, &JobScheduler::statusUpdated, &app, [](const QString &status) {
+        printEvent({ { "event", "status" }, { "message", status } });
+    });
+    QObject::connect(&scheduler, &JobScheduler::errorOccurred, &app, [&](const QString &message) {
+        exitCode = 1;
+        printEvent({ { "event", "error" }, { "message", message } });
+    });
+    QObject::connect(&scheduler, &JobScheduler::progressUpdated, &app, [&](int progress) {
+        if (progress != lastProgress) {
+            lastProgress = progress;
+            printEvent({ { "event", "progress" }, { "percent", progress } });
+        }
+    });
+    QObject::connect(&scheduler, &JobScheduler::jobFinished, &app,
+                     [&](const QString &name, int processed, int skipped, int total) {
+        printEvent({ { "event", "job" },
+                     { "name", name },
+                     { "processed", processed },
+                     { "failed", total - processed },
+                     { "skipped", skipped },
+                     { "total", total },
+                     { "elapsedMs", runTimer.elapsed() } });
+    });
+    QObject::connect(&scheduler, &JobScheduler::runCompleted, &app, [&](int processed, int skipped, int total) {
+        if (processed < total) {
+            exitCode = 1;
+        }
+        printEvent({ { "event", "summary" },
+                     { "processed", processed },
+                     { "failed", total - processed },
+                     { "skipped", skipped },
+                     { "total", total },
+                     { "elapsedMs", runTimer.elapsed() } });
+    });
+    QObject::connect(&scheduler, &QThread::finished, &app, [&]() {
+        QCoreApplication::exit(exitCode);
+    });
+
+    std::signal(SIGINT, requestTerminate);
+    std::signal(SIGTERM, requestTerminate);
+    QObject::connect(&terminateTimer, &QTimer::timeout, &app, [&]() {
+        if (s_terminateRequested) {
+            scheduler.stop();
+        }
+    });
+    terminateTimer.start(200);
+
+    runTimer.start();
+    scheduler.start();
+    return QCoreApplication::exec();
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    app.setApplicationName("fileprocessor_cli");
+    app.setApplicationVersion("1.0");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("XOR file processor (headless)");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addOptions({
+        { "config", "INI file with default values for the options below.", "file" },
+        { "input", "Input directory.", "path" },
+        { "output", "Output directory.", "path" },
+        { "mask", "File mask, e.g. \"*.txt;*.bin\" (default: *).", "mask" },
+        { "key", "XOR key in hex, any length; the rightmost byte is applied first.", "hex" },
+        { "key-file", "Read the XOR key bytes from a file instead of --key.", "file" },
+        { "recursive", "Include subdirectories." },
+        { "delete", "Delete input files after processing." },
+        { "rename", "Add a counter instead of overwriting existing output files." },
+        { "in-place", "Transform in place and move when input and output share a volume." },
+        { "pack", "Append outputs to indexed segment files instead of writing one file each." },
+        { "segment-size", "Maximum size of a pack segment in bytes (default: 1 GiB).", "bytes" },
+        { "workers", "Worker threads, 0 = auto.", "count" },
+        { "engine", "I/O engine: buffered, mmap or uring.", "engine" },
+        { "cache", "Page cache policy: page, drop or direct.", "policy" },
+        { "durability", "Sync policy: none, file (fdatasync each output) or group (syncfs per batch).", "policy" },
+        { "buffer-size", "Buffer size in bytes, 0 = tuned per device.", "bytes" },
+        { "queue-depth", "Buffers in flight per worker.", "count" },
+        { "skip-unchanged", "Skip files already processed and not modified since." },
+        { "content-hash", "Compare content hashes when checking for changes." },
+        { "index", "Processed-file index path.", "file" },
+        { "resume", "Checkpoint progress and continue an interrupted run." },
+        { "checksum", "Write output checksums to xor-manifest.txt: none, crc32c or xxhash64.", "algorithm" },
+        { "checksum-input", "Also record checksums of the input files." },
+        { "verify", "Check the output directory against its manifest instead of processing." },
+        { "metrics-file", "Periodically rewrite run metrics to this file.", "file" },
+        { "metrics-format", "Metrics file format: json or prometheus.", "format" },
+        { "metrics-interval", "Metrics export interval in milliseconds (default: 1000).", "ms" },
+        { "watch", "Keep running and process files as they appear in the input directory." },
+        { "interval", "Keep running and rescan the input directory every N seconds.", "seconds" },
+        { "jobs", "INI file with one group per job; runs the jobs together on one worker pool.", "file" },
+        { "order", "File order for --jobs: largest, smallest or discovery (default: largest).", "order" },
+        { "device-concurrency", "Files open at once per device for --jobs, 0 = one on spinning disks.", "count" },
+    });
+    parser.process(app);
+
+    if (parser.isSet("jobs")) {
+        return runJobs(app, parser);
+    }
+
+    QScopedPointer<QSettings> config;
+    if (parser.isSet("config")) {
+        config.reset(new QSettings(parser.value("config"), QSettings::IniFormat));
+        if (config->status() != QSettings::NoError) {
+            printEvent({ { "event", "error" }, { "message", "Не удалось прочитать файл настроек: " + parser.value("config") } });
+            return 2;
+        }
+    }
+
+    FileProcessorSettings settings;
+    QString error;
+    if (!parseSettings(parser, config.data(), &settings, &error)) {
+        printEvent({ { "event", "error" }, { "message", error } });
+        return 2;
+    }
+
+    bool ok = true;
+    const int interval = optionValue(parser, config.data(), "interval", "0").toInt(&ok);
+    const bool watch = optionFlag(parser, config.data(), "watch");
+    if (!ok || interval < 0) {
+        printEvent({ { "event", "error" }, { "message", "Некорректный интервал" } });
+        return 2;
+    }
+    const bool daemon = (watch || interval > 0) && !settings.verifyManifest;
+
+    FileProcessor processor;
+    processor.setSettings(settings);
+
+    DirectoryWatcher watcher;
+    QTimer intervalTimer;
+    QTimer terminateTimer;
+    QSet<QString> pendingFiles;
+    QElapsedTimer runTimer;
+    bool stopping = false;
+    int exitCode = 0;
+    int lastProgress = -1;
+
+    auto startRun = [&](const QStringList &files) {
+        if (stopping || processor.isRunning()) {
+            return;
+        }
+        processor.setInputFiles(files);
+        lastProgress = -1;
+        runTimer.start();
+        processor.start();
+    };
+
+    auto takePendingFiles = [&]() {
+        QStringList files = pendingFiles.values();
+        files.sort();
+        pendingFiles.clear();
+        return files;
+    };
+
+    auto shutdown = [&]() {
+        stopping = true;
+        intervalTimer.stop();
+        watcher.stop();
+        if (processor.isRunning()) {
+            processor.stop();
+        } else {
+            QCoreApplication::exit(exitCode);
+        }
+    };
+
+    // The processor emits from its own thread; with the application as context every
+    // handler is queued to the main thread, which owns the state below.
+    QObject::connect(&processor, &FileProcessor::statusUpdated, &app, [](const QString &status) {
+        printEvent({ { "event", "status" }, { "message", status } });
+    });
+    QObject::connect(&processor, &FileProcessor::errorOccurred, &app, [&](const QString &message) {
+        exitCode = 1;
+        printEvent({ { "event", "error" }, { "message", message } });
+    });
+    QObject::connect(&processor, &FileProcessor::progressUpdated, &app, [&](int progress) {
+        if (progress != lastProgress) {
+            lastProgress = progress;
+            printEvent({ { "event", "progress" }, { "percent", progress } });
+        }
+    });
+    QObject::connect(&processor, &FileProcessor::runCompleted, &app, [&](int processed, int skipped, int total) {
+        if (processed < total) {
+            exitCode = 1;
+        }
+        printEvent({ { "event", "summary" },
+                     { "processed", processed },
+                     { "failed", total - processed },
+                     { "skipped", skipped },
+                     { "total", total },
+                     { "elapsedMs", runTimer.elapsed() } });
+    });
+    QObject::connect(&processor, &QThread::finished, &app, [&]() {
+        if (stopping || !daemon) {
+            QCoreApplication::exit(exitCode);
+        } else if (!pendingFiles.isEmpty() && !processor.isRunning()) {
+            startRun(takePendingFiles());
+        }
+    });
+
+    QObject::connect(&watcher, &DirectoryWatcher::filesReady, &app, [&](const QStringList &files) {
+        for (const QString &file : files) {
+            pendingFiles.insert(file);
+        }
+        if (!processor.isRunning()) {
+            startRun(takePendingFiles());
+        }
+    });
+    QObject::connect(&intervalTimer, &QTimer::timeout, &app, [&]() {
+        startRun(QStringList());
+    });
+
+    // Signal handlers only raise a flag; the event loop picks it up.
+    std::signal(SIGINT, requestTerminate);
+    std::signal(SIGTERM, requestTerminate);
+    QObject::connect(&terminateTimer, &QTimer::timeout, &app, [&]() {
+        if (s_terminateRequested && !stopping) {
+            shutdown();
+        }
+    });
+    terminateTimer.start(200);
+
+    if (watch && daemon) {
+        watcher.start(settings.inputPath, FileProcessor::fileMaskFilters(settings.fileMask), settings.recursive,
+                      settings.outputPath);
+        printEvent({ { "event", "watching" },
+                     { "path", settings.inputPath },
+                     { "backend", watcher.usesInotify() ? "inotify" : "QFileSystemWatcher" } });
+    }
+    if (interval > 0 && daemon) {
+        intervalTimer.start(interval * 1000);
+    }
+
+    startRun(QStringList());
+
+    return app.exec();
+}
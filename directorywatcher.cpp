@@ -0,0 +1,311 @@
+#include "directorywatcher.h"
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QSocketNotifier>
+#include <QTimer>
+
+#ifdef Q_OS_LINUX
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+DirectoryWatcher::DirectoryWatcher(QObject *parent)
+    : QObject(parent)
+    , m_recursive(false)
+    , m_inotifyFd(-1)
+    , m_notifier(nullptr)
+    , m_fallbackWatcher(nullptr)
+    , m_rescanTimer(new QTimer(this))
+    , m_debounceTimer(new QTimer(this))
+{
+    m_debounceTimer->setSingleShot(true);
+    m_debounceTimer->setInterval(DEBOUNCE_MS);
+    connect(m_debounceTimer, &QTimer::timeout, this, &DirectoryWatcher::flushPending);
+
+    m_rescanTimer->setSingleShot(true);
+    m_rescanTimer->setInterval(DEBOUNCE_MS);
+    connect(m_rescanTimer, &QTimer::timeout, this, &DirectoryWatcher::rescanDirectory);
+}
+
+DirectoryWatcher::~DirectoryWatcher()
+{
+    stop();
+}
+
+bool DirectoryWatcher::start(const QString &path, const QStringList &nameFilters, bool recursive,
+                             const QString &excludedPath)
+{
+    stop();
+
+    m_path = QDir(path).absolutePath();
+    m_nameFilters = nameFilters;
+    m_recursive = recursive;
+    m_excludedPath = excludedPath.isEmpty() ? QString() : QDir(excludedPath).absolutePath();
+
+    if (!QDir(m_path).exists()) {
+        return false;
+    }
+
+    if (!startInotify()) {
+        startFallback();
+    }
+
+    return true;
+}
+
+void DirectoryWatcher::stop()
+{
+    m_debounceTimer->stop();
+    m_rescanTimer->stop();
+    m_pending.clear();
+    m_snapshot.clear();
+
+    delete m_notifier;
+    m_notifier = nullptr;
+
+    delete m_fallbackWatcher;
+    m_fallbackWatcher = nullptr;
+
+#ifdef Q_OS_LINUX
+    if (m_inotifyFd >= 0) {
+        ::close(m_inotifyFd);
+    }
+#endif
+    m_inotifyFd = -1;
+    m_watchedDirs.clear();
+}
+
+bool DirectoryWatcher::usesInotify() const
+{
+    return m_inotifyFd >= 0;
+}
+
+bool DirectoryWatcher::startInotify()
+{
+#ifdef Q_OS_LINUX
+    m_inotifyFd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_inotifyFd < 0) {
+        return false;
+    }
+
+    if (!addInotifyWatch(m_path)) {
+        ::close(m_inotifyFd);
+        m_inotifyFd = -1;
+        return false;
+    }
+    if (m_recursive) {
+        watchSubdirectories(m_path);
+    }
+
+    m_notifier = new QSocketNotifier(m_inotifyFd, QSocketNotifier::Read, this);
+    connect(m_notifier, &QSocketNotifier::activated, this, &DirectoryWatcher::readInotifyEvents);
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool DirectoryWatcher::addInotifyWatch(const QString &dirPath)
+{
+#ifdef Q_OS_LINUX
+    // Files are picked up once the writer closes them, or when they are moved in whole.
+    // A recursive watch also needs to hear about new directories.
+    const int wd = ::inotify_add_watch(m_inotifyFd, QFile::encodeName(dirPath).constData(),
+                                       IN_CLOSE_WRITE | IN_MOVED_TO | IN_ONLYDIR | (m_recursive ? IN_CREATE : 0));
+    if (wd < 0) {
+        return false;
+    }
+    m_watchedDirs.insert(wd, dirPath);
+    return true;
+#else
+    Q_UNUSED(dirPath)
+    return false;
+#endif
+}
+
+void DirectoryWatcher::watchSubdirectories(const QString &dirPath)
+{
+    QDirIterator it(dirPath, QDir::Dirs | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        const QString subdirPath = QFileInfo(it.next()).absoluteFilePath();
+        if (isExcluded(subdirPath)) {
+            continue;
+        }
+        if (m_inotifyFd >= 0) {
+            addInotifyWatch(subdirPath);
+        } else if (m_fallbackWatcher && !m_fallbackWatcher->directories().contains(subdirPath)) {
+            m_fallbackWatcher->addPath(subdirPath);
+        }
+    }
+}
+
+void DirectoryWatcher::startFallback()
+{
+    for (const QFileInfo &fileInfo : listFiles(m_path)) {
+        Snapshot snapshot;
+        snapshot.size = fileInfo.size();
+        snapshot.modified = fileInfo.lastModified().toMSecsSinceEpoch();
+        snapshot.reported = true;
+        m_snapshot.insert(fileInfo.absoluteFilePath(), snapshot);
+    }
+
+    m_fallbackWatcher = new QFileSystemWatcher(this);
+    m_fallbackWatcher->addPath(m_path);
+    if (m_recursive) {
+        watchSubdirectories(m_path);
+    }
+    connect(m_fallbackWatcher, &QFileSystemWatcher::directoryChanged, this, [this]() {
+        m_rescanTimer->start();
+    });
+}
+
+QFileInfoList DirectoryWatcher::listFiles(const QString &dirPath) const
+{
+    QFileInfoList files;
+    QDirIterator it(dirPath, m_nameFilters, QDir::Files | QDir::Readable,
+                    m_recursive ? QDirIterator::Subdirectories : QDirIterator::NoIteratorFlags);
+    while (it.hasNext()) {
+        const QFileInfo fileInfo(it.next());
+        if (!isExcluded(fileInfo.absoluteFilePath())) {
+            files << fileInfo;
+        }
+    }
+    return files;
+}
+
+bool DirectoryWatcher::isExcluded(const QString &path) const
+{
+    return !m_excludedPath.isEmpty() && (path == m_excludedPath || path.startsWith(m_excludedPath + '/'));
+}
+
+void DirectoryWatcher::readInotifyEvents()
+{
+#ifdef Q_OS_LINUX
+    alignas(struct inotify_event) char buffer[16 * 1024];
+
+    for (;;) {
+        const ssize_t length = ::read(m_inotifyFd, buffer, sizeof(buffer));
+        if (length < 0 && errno == EINTR) {
+            continue;
+        }
+        if (length <= 0) {
+            break;
+        }
+
+        for (ssize_t offset = 0; offset < length;) {
+            const struct inotify_event *event = reinterpret_cast<const struct inotify_event *>(buffer + offset);
+            offset += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                // Events were dropped; fall back to one full listing to catch up.
+                if (m_recursive) {
+                    watchSubdirectories(m_path);
+                }
+                for (const QFileInfo &fileInfo : listFiles(m_path)) {
+                    enqueue(fileInfo.absoluteFilePath());
+                }
+                continue;
+            }
+            if (event->mask & IN_IGNORED) {
+                m_watchedDirs.remove(event->wd);
+                continue;
+            }
+
+            const auto dirIt = m_watchedDirs.constFind(event->wd);
+            if (event->len == 0 || dirIt == m_watchedDirs.constEnd()) {
+                continue;
+            }
+            const QString filePath = QDir(*dirIt).absoluteFilePath(QFile::decodeName(event->name));
+
+            if (event->mask & IN_ISDIR) {
+                // Files can land in a new directory before its watch exists, so whatever
+                // it already holds is reported with it.
+                if (m_recursive && !isExcluded(filePath) && addInotifyWatch(filePath)) {
+                    watchSubdirectories(filePath);
+                    for (const QFileInfo &fileInfo : listFiles(filePath)) {
+                        enqueue(fileInfo.absoluteFilePath());
+                    }
+                }
+                continue;
+            }
+
+            // Creation of a file is only heard for the sake of directories; it is
+            // reported once closed.
+            if ((event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) && matches(QFileInfo(filePath).fileName())) {
+                enqueue(filePath);
+            }
+        }
+    }
+#endif
+}
+
+void DirectoryWatcher::rescanDirectory()
+{
+    if (m_recursive) {
+        watchSubdirectories(m_path);
+    }
+
+    // Without close notifications a file is only reported once its size and
+    // mtime have stayed the same across two consecutive scans.
+    QHash<QString, Snapshot> current;
+    bool unsettled = false;
+
+    for (const QFileInfo &fileInfo : listFiles(m_path)) {
+        const QString filePath = fileInfo.absoluteFilePath();
+        Snapshot snapshot;
+        snapshot.size = fileInfo.size();
+        snapshot.modified = fileInfo.lastModified().toMSecsSinceEpoch();
+
+        auto it = m_snapshot.constFind(filePath);
+        if (it != m_snapshot.constEnd() && it->size == snapshot.size && it->modified == snapshot.modified) {
+            snapshot.reported = it->reported;
+            if (!snapshot.reported) {
+                enqueue(filePath);
+                snapshot.reported = true;
+            }
+        } else {
+            unsettled = true;
+        }
+
+        current.insert(filePath, snapshot);
+    }
+
+    m_snapshot = current;
+
+    if (unsettled) {
+        m_rescanTimer->start();
+    }
+}
+
+void DirectoryWatcher::flushPending()
+{
+    if (m_pending.isEmpty()) {
+        return;
+    }
+
+    QStringList files = m_pending.values();
+    files.sort();
+    m_pending.clear();
+
+    emit filesReady(files);
+}
+
+bool DirectoryWatcher::matches(const QString &fileName) const
+{
+    return m_nameFilters.isEmpty() || QDir::match(m_nameFilters, fileName);
+}
+
+// Each event restarts the debounce, but never past MAX_DELAY_MS after the first pending
+// file, or a steady feed would never be flushed.
+void DirectoryWatcher::enqueue(const QString &filePath)
+{
+    if (m_pending.isEmpty()) {
+        m_pendingSince.start();
+    }
+    m_pending.insert(filePath);
+    m_debounceTimer->start(int(qBound<qint64>(0, MAX_DELAY_MS - m_pendingSince.elapsed(), DEBOUNCE_MS)));
+}
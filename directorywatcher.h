@@ -0,0 +1,76 @@
+#ifndef DIRECTORYWATCHER_H
+#define DIRECTORYWATCHER_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QSet>
+
+class QSocketNotifier;
+class QFileSystemWatcher;
+class QTimer;
+
+class DirectoryWatcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit DirectoryWatcher(QObject *parent = nullptr);
+    ~DirectoryWatcher();
+
+    // A recursive watch also follows subdirectories, including ones created later;
+    // the excluded directory, such as an output folder inside the input, is skipped.
+    bool start(const QString &path, const QStringList &nameFilters, bool recursive = false,
+               const QString &excludedPath = QString());
+    void stop();
+    bool usesInotify() const;
+
+signals:
+    void filesReady(const QStringList &files);
+
+private slots:
+    void readInotifyEvents();
+    void rescanDirectory();
+    void flushPending();
+
+private:
+    struct Snapshot
+    {
+        qint64 size = -1;
+        qint64 modified = 0;
+        bool reported = false;
+    };
+
+    bool startInotify();
+    bool addInotifyWatch(const QString &dirPath);
+    void watchSubdirectories(const QString &dirPath);
+    void startFallback();
+    QFileInfoList listFiles(const QString &dirPath) const;
+    bool isExcluded(const QString &path) const;
+    bool matches(const QString &fileName) const;
+    void enqueue(const QString &filePath);
+
+    QString m_path;
+    QStringList m_nameFilters;
+    bool m_recursive;
+    QString m_excludedPath;
+
+    int m_inotifyFd;
+    QHash<int, QString> m_watchedDirs;
+    QSocketNotifier *m_notifier;
+    QFileSystemWatcher *m_fallbackWatcher;
+    QTimer *m_rescanTimer;
+    QHash<QString, Snapshot> m_snapshot;
+
+    QSet<QString> m_pending;
+    QElapsedTimer m_pendingSince;
+    QTimer *m_debounceTimer;
+
+    static const int DEBOUNCE_MS = 250;
+    static const int MAX_DELAY_MS = 2000;
+};
+
+#endif // DIRECTORYWATCHER_H
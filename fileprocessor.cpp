@@ -1,13 +1,306 @@
 #include "fileprocessor.h"
+#include "xorkernel.h"
+#include "bufferpool.h"
+#include "blockingqueue.h"
+#include "uringengine.h"
+#include "processedindex.h"
+#include "jobcheckpoint.h"
+#include "buffertuner.h"
+#include "checksummanifest.h"
+#include "packarchive.h"
 #include <QFile>
 #include <QDir>
 #include <QFileInfo>
+#include <QDirIterator>
 #include <QDebug>
+#include <QThreadPool>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QStorageInfo>
+#include <QScopedPointer>
+#include <QElapsedTimer>
+#include <QWaitCondition>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+#ifdef Q_OS_LINUX
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+namespace {
+
+const char JOURNAL_SUFFIX[] = ".xorjournal";
+const char PART_SUFFIX[] = ".xorpart";
+const quint32 JOURNAL_MAGIC = 0x584a524e;
+
+// Progress of an in-place pass. [offset, offset + pendingLength) is the step being
+// rewritten; pendingHash is the hash of its original bytes, which tells on resume
+// whether that step reached the disk untouched, fully transformed, or torn. device,
+// fileId and size identify the file the journal was written for.
+struct InPlaceJournal
+{
+    quint64 xorValue = 0;
+    qint64 offset = 0;
+    qint64 pendingLength = 0;
+    quint64 pendingHash = 0;
+    quint64 device = 0;
+    quint64 fileId = 0;
+    qint64 size = -1;
+};
+
+bool loadJournal(const QString &path, InPlaceJournal *journal)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream stream(&file);
+    quint32 magic = 0;
+    stream >> magic >> journal->xorValue >> journal->offset >> journal->pendingLength >> journal->pendingHash
+           >> journal->device >> journal->fileId >> journal->size;
+
+    return stream.status() == QDataStream::Ok && magic == JOURNAL_MAGIC;
+}
+
+bool saveJournal(const QString &path, const InPlaceJournal &journal)
+{
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream << JOURNAL_MAGIC << journal.xorValue << journal.offset << journal.pendingLength << journal.pendingHash
+           << journal.device << journal.fileId << journal.size;
+
+    return stream.status() == QDataStream::Ok && file.commit();
+}
+
+// A crash between moving a finished file away and removing its journal leaves the
+// journal behind; a later file of the same name must not resume from it.
+bool journalMatchesFile(const InPlaceJournal &journal, const QString &filePath)
+{
+    ProcessedIndex::Stamp stamp;
+    return ProcessedIndex::stampOf(filePath, false, &stamp) && stamp.device == journal.device
+        && stamp.fileId == journal.fileId && stamp.size == journal.size;
+}
+
+quint64 hashBytes(const char *data, qint64 size)
+{
+    quint64 hash = 14695981039346656037ULL;
+    for (qint64 i = 0; i < size; ++i) {
+        hash ^= static_cast<uchar>(data[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+bool syncFileData(QFile &file)
+{
+    if (!file.flush()) {
+        return false;
+    }
+#if defined(Q_OS_LINUX)
+    return ::fdatasync(file.handle()) == 0;
+#elif defined(Q_OS_UNIX)
+    return ::fsync(file.handle()) == 0;
+#else
+    return true;
+#endif
+}
+
+// Page-cache hints for CachePolicy::DropCache; no-ops where the calls are unavailable.
+void dropCleanRange(int fd, qint64 offset, qint64 length)
+{
+#ifdef Q_OS_LINUX
+    ::posix_fadvise(fd, offset, length, POSIX_FADV_DONTNEED);
+#else
+    Q_UNUSED(fd) Q_UNUSED(offset) Q_UNUSED(length)
+#endif
+}
+
+void startWriteback(int fd, qint64 offset, qint64 length)
+{
+#ifdef Q_OS_LINUX
+    ::sync_file_range(fd, offset, length, SYNC_FILE_RANGE_WRITE);
+#else
+    Q_UNUSED(fd) Q_UNUSED(offset) Q_UNUSED(length)
+#endif
+}
+
+void dropWrittenRange(int fd, qint64 offset, qint64 length)
+{
+#ifdef Q_OS_LINUX
+    ::sync_file_range(fd, offset, length,
+                      SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+    ::posix_fadvise(fd, offset, length, POSIX_FADV_DONTNEED);
+#else
+    Q_UNUSED(fd) Q_UNUSED(offset) Q_UNUSED(length)
+#endif
+}
+
+void preallocate(int fd, qint64 size)
+{
+#ifdef Q_OS_LINUX
+    // KEEP_SIZE reserves contiguous extents without changing the file size, so a short
+    // write never leaves zero padding behind. Filesystems without support just fail.
+    ::fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, size);
+#else
+    Q_UNUSED(fd) Q_UNUSED(size)
+#endif
+}
+
+#ifdef Q_OS_UNIX
+bool syncDescriptor(int fd, bool dataOnly)
+{
+#ifdef Q_OS_LINUX
+    return (dataOnly ? ::fdatasync(fd) : ::fsync(fd)) == 0;
+#else
+    Q_UNUSED(dataOnly)
+    return ::fsync(fd) == 0;
+#endif
+}
+#endif
+
+bool syncPath(const QString &path, bool dataOnly)
+{
+#ifdef Q_OS_UNIX
+    const int fd = ::open(QFile::encodeName(path).constData(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    const bool ok = syncDescriptor(fd, dataOnly);
+    ::close(fd);
+    return ok;
+#else
+    Q_UNUSED(path) Q_UNUSED(dataOnly)
+    return true;
+#endif
+}
+
+bool syncFileSystem(const QString &path)
+{
+#if defined(Q_OS_LINUX)
+    const int fd = ::open(QFile::encodeName(path).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    const bool ok = ::syncfs(fd) == 0;
+    ::close(fd);
+    return ok;
+#elif defined(Q_OS_UNIX)
+    Q_UNUSED(path)
+    ::sync();
+    return true;
+#else
+    Q_UNUSED(path)
+    return true;
+#endif
+}
+
+// Moves a finished output over its final name in one step, so the final name only
+// ever refers to a complete file.
+bool replaceFile(const QString &from, const QString &to)
+{
+#ifdef Q_OS_UNIX
+    return ::rename(QFile::encodeName(from).constData(), QFile::encodeName(to).constData()) == 0;
+#else
+    QFile::remove(to);
+    return QFile::rename(from, to);
+#endif
+}
+
+// Like replaceFile, but fails instead of replacing a file that took the final name
+// after it was reserved.
+bool publishFile(const QString &from, const QString &to)
+{
+#ifdef Q_OS_UNIX
+    const QByteArray fromName = QFile::encodeName(from);
+    const QByteArray toName = QFile::encodeName(to);
+#if defined(Q_OS_LINUX) && defined(SYS_renameat2)
+    // Called directly, since the C library may predate the renameat2 wrapper.
+    if (::syscall(SYS_renameat2, AT_FDCWD, fromName.constData(), AT_FDCWD, toName.constData(),
+                  RENAME_NOREPLACE) == 0) {
+        return true;
+    }
+    if (errno != EINVAL && errno != ENOSYS) {
+        return false;
+    }
+#endif
+    // Without renameat2 a hard link claims the name just as exclusively.
+    if (::link(fromName.constData(), toName.constData()) == 0) {
+        ::unlink(fromName.constData());
+        return true;
+    }
+    if (errno == EEXIST || QFile::exists(to)) {
+        return false;
+    }
+    return ::rename(fromName.constData(), toName.constData()) == 0;
+#else
+    return QFile::rename(from, to);
+#endif
+}
+
+#ifdef Q_OS_UNIX
+qint64 preadFully(int fd, char *buffer, qint64 size, qint64 offset)
+{
+    qint64 done = 0;
+    while (done < size) {
+        ssize_t n = ::pread(fd, buffer + done, size - done, offset + done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return n < 0 ? -1 : done;
+        }
+        done += n;
+    }
+    return done;
+}
+
+bool pwriteFully(int fd, const char *buffer, qint64 size, qint64 offset)
+{
+    qint64 done = 0;
+    while (done < size) {
+        ssize_t n = ::pwrite(fd, buffer + done, size - done, offset + done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        done += n;
+    }
+    return true;
+}
+#endif
+
+} // namespace
 
 FileProcessor::FileProcessor(QObject *parent)
     : QThread(parent)
     , m_stopRequested(false)
+    , m_lastDiscoveredCount(0)
+    , m_bufferSize(BUFFER_SIZE)
+    , m_chunkSize(BUFFER_SIZE)
+    , m_clonedCount(0)
+    , m_rangeCopiedCount(0)
+    , m_plainCopiedCount(0)
+    , m_outputNames(PART_SUFFIX)
 {
+    qRegisterMetaType<ProcessingMetrics::Snapshot>();
 }
 
 void FileProcessor::setSettings(const FileProcessorSettings &settings)
@@ -15,6 +308,11 @@ void FileProcessor::setSettings(const FileProcessorSettings &settings)
     m_settings = settings;
 }
 
+void FileProcessor::setInputFiles(const QStringList &files)
+{
+    m_inputFiles = files;
+}
+
 void FileProcessor::stop()
 {
     m_stopRequested = true;
@@ -24,174 +322,1870 @@ void FileProcessor::run()
 {
     m_stopRequested = false;
 
-    emit statusUpdated("Поиск файлов для обработки...");
-
-    QStringList inputFiles = findInputFiles();
+    if (m_settings.verifyManifest) {
+        runVerification();
+        return;
+    }
 
-    if (inputFiles.isEmpty()) {
-        emit statusUpdated("Файлы для обработки не найдены");
+    if (!prepareRun()) {
         return;
     }
 
-    emit statusUpdated(QString("Найдено файлов: %1").arg(inputFiles.size()));
+    const QDir outputDir = m_outputDir;
+    const bool fullScan = m_inputFiles.isEmpty();
+    const bool identityKey = m_settings.key.kind() == XorKey::IdentityKey;
+    const bool packed = m_settings.outputFormat == FileProcessorSettings::PackedSegments;
+    const int workerCount = qMax(1, m_settings.workerCount > 0 ? m_settings.workerCount : QThread::idealThreadCount());
+    const qint64 bufferSize = m_bufferSize;
+    const int queueDepth = qMax(2, m_settings.queueDepth);
 
-    QDir outputDir(m_settings.outputPath);
-    if (!outputDir.exists()) {
-        if (!outputDir.mkpath(".")) {
-            emit errorOccurred("Не удалось создать выходную папку: " + m_settings.outputPath);
-            return;
+    // io_uring completes reads out of order, which a streaming hash cannot follow, and
+    // its engine only reads and writes: no cache hints, preallocation or range checkpoints.
+    QString uringBlocker;
+    if (m_manifest) {
+        uringBlocker = "контрольные суммы";
+    } else if (packed) {
+        uringBlocker = "упакованный вывод";
+    } else if (m_settings.cachePolicy != FileProcessorSettings::PageCache) {
+        uringBlocker = "политика кэша";
+    } else if (m_settings.durability != FileProcessorSettings::NoSync) {
+        uringBlocker = "сохранение на диск";
+    } else if (m_checkpoint && m_settings.largeFileThreshold > 0) {
+        uringBlocker = "возобновление больших файлов";
+    }
+    const bool uringAllowed = !identityKey && uringBlocker.isEmpty();
+    if (m_settings.ioEngine == FileProcessorSettings::UringIo) {
+        if (!uringBlocker.isEmpty()) {
+            emit statusUpdated("io_uring отключен (" + uringBlocker + "), используется обычный ввод-вывод");
+        } else if (uringAllowed && !UringEngine::isSupported()) {
+            emit statusUpdated("io_uring недоступен, используется обычный ввод-вывод");
         }
     }
 
-    int processedCount = 0;
-    int totalCount = inputFiles.size();
+    BlockingQueue<QString> inputQueue(INPUT_QUEUE_CAPACITY);
+    QAtomicInt discoveredCount(0);
+    QAtomicInt skippedCount(0);
+    QAtomicInt processedCount(0);
+    QAtomicInt finishedCount(0);
+    std::atomic<bool> enumerationDone(false);
 
-    for (const QString &inputFile : inputFiles) {
-        if (m_stopRequested) {
-            emit statusUpdated("Обработка прервана пользователем");
-            break;
+    // Until enumeration finishes the total is unknown: estimate it from the previous
+    // full scan and hold progress below 100% until the real count is in.
+    const int expectedCount = fullScan ? m_lastDiscoveredCount : m_inputFiles.size();
+    auto currentProgress = [&]() {
+        const int finished = finishedCount.loadRelaxed();
+        const int discovered = discoveredCount.loadRelaxed();
+        const bool done = enumerationDone;
+        const int estimate = done ? discovered : qMax(discovered, expectedCount);
+        int progress = estimate > 0 ? static_cast<int>((qint64(finished) * 100) / estimate) : 0;
+        if (!done) {
+            progress = qMin(progress, 99);
         }
+        return progress;
+    };
 
-        QFileInfo fileInfo(inputFile);
-        QString outputFileName = fileInfo.fileName();
-        QString outputFilePath = outputDir.absoluteFilePath(outputFileName);
+    // Progress, the current file name and metrics are sampled at a fixed rate from a
+    // separate thread, so neither the workers nor a producer blocked on a full queue
+    // decide how often the GUI thread is woken up.
+    QMutex reporterMutex;
+    QWaitCondition reporterWake;
+    bool reporterDone = false;
+
+    std::thread reporter([&]() {
+        const int metricsInterval = qMax(REPORT_INTERVAL_MS, m_settings.metricsIntervalMs);
+        QElapsedTimer metricsTimer;
+        metricsTimer.start();
+        int lastProgress = -1;
+        QString lastFile;
+
+        QMutexLocker locker(&reporterMutex);
+        while (!reporterDone) {
+            reporterWake.wait(&reporterMutex, REPORT_INTERVAL_MS);
+            locker.unlock();
+
+            const int progress = currentProgress();
+            if (progress != lastProgress) {
+                lastProgress = progress;
+                emit progressUpdated(progress);
+            }
+
+            QString file;
+            {
+                QMutexLocker fileLocker(&m_currentFileMutex);
+                file = m_currentFile;
+            }
+            if (file != lastFile) {
+                lastFile = file;
+                emit currentFileChanged(file);
+            }
+
+            if (metricsTimer.elapsed() >= metricsInterval) {
+                m_metrics.setInputQueueDepth(inputQueue.size());
+                publishMetrics();
+                metricsTimer.restart();
+            }
 
-        if (!m_settings.overwriteOutput && QFile::exists(outputFilePath)) {
-            outputFilePath = generateUniqueFileName(outputFilePath);
+            locker.relock();
         }
+    });
 
-        emit statusUpdated(QString("Обработка: %1").arg(fileInfo.fileName()));
+    QThreadPool workers;
+    workers.setMaxThreadCount(workerCount);
 
-        if (processFile(inputFile, outputFilePath)) {
-            processedCount++;
+    for (int i = 0; i < workerCount; ++i) {
+        workers.start([&]() {
+            BufferPool pool(queueDepth, bufferSize);
 
-            if (m_settings.deleteInputFiles) {
-                if (!QFile::remove(inputFile)) {
-                    emit errorOccurred(QString("Не удалось удалить входной файл: %1").arg(inputFile));
+            QScopedPointer<UringEngine> uring;
+            // An identity key goes file by file, where processFile can copy in the kernel.
+            if (m_settings.ioEngine == FileProcessorSettings::UringIo && uringAllowed && UringEngine::isSupported()) {
+                uring.reset(new UringEngine(queueDepth, bufferSize, m_settings.key));
+                if (!uring->isValid()) {
+                    uring.reset();
                 }
             }
-        } else {
-            emit errorOccurred(QString("Не удалось обработать файл: %1").arg(inputFile));
+
+#ifdef Q_OS_UNIX
+            const bool smallFileBatching = !uring && !identityKey && !packed
+                && m_settings.cachePolicy != FileProcessorSettings::DirectIo
+                && !(m_settings.deleteInputFiles && m_settings.transformInPlace);
+#else
+            const bool smallFileBatching = false;
+#endif
+            std::vector<char> arena;
+            auto nextInputFile = [&](QString *file) { return inputQueue.tryPop(file); };
+
+            QString inputFile;
+            while (!m_stopRequested && inputQueue.pop(&inputFile)) {
+                m_metrics.adjustActiveWorkers(1);
+
+                if (uring) {
+                    QStringList batch;
+                    batch << inputFile;
+                    while (batch.size() < queueDepth && inputQueue.tryPop(&inputFile)) {
+                        batch << inputFile;
+                    }
+                    processedCount.fetchAndAddRelaxed(processInputBatch(batch, outputDir, *uring));
+                    finishedCount.fetchAndAddRelaxed(batch.size());
+#ifdef Q_OS_UNIX
+                } else if (smallFileBatching) {
+                    if (arena.empty()) {
+                        arena.resize(SMALL_FILE_ARENA_SIZE);
+                    }
+                    int handledCount = 0;
+                    processedCount.fetchAndAddRelaxed(
+                        processSmallFileBatch(inputFile, nextInputFile, outputDir, pool, arena, &handledCount));
+                    finishedCount.fetchAndAddRelaxed(handledCount);
+#endif
+                } else {
+                    QElapsedTimer fileTimer;
+                    fileTimer.start();
+                    const bool ok = processInputFile(inputFile, outputDir, pool);
+                    reportFile(inputFile, fileTimer.nsecsElapsed(), ok);
+                    if (ok) {
+                        processedCount.ref();
+                    }
+                    finishedCount.ref();
+                }
+
+                m_metrics.adjustActiveWorkers(-1);
+            }
+
+            if (m_stopRequested) {
+                inputQueue.close();
+            }
+        });
+    }
+
+    auto offerInputFile = [&](const QString &inputFile) {
+        if (!acceptInputFile(inputFile)) {
+            skippedCount.ref();
+            return !m_stopRequested;
+        }
+
+        discoveredCount.ref();
+        return inputQueue.push(inputFile) && !m_stopRequested;
+    };
+
+    if (fullScan) {
+        emit statusUpdated("Поиск файлов для обработки...");
+        enumerateInputFiles(offerInputFile);
+    } else {
+        // Watched subdirectories can include the output folder when it lies inside the input.
+        const QString outputRoot = QDir(m_settings.outputPath).absolutePath() + '/';
+        for (const QString &inputFile : m_inputFiles) {
+            if (!inputFile.endsWith(JOURNAL_SUFFIX) && !inputFile.endsWith(PART_SUFFIX) && QFileInfo(inputFile).isFile()
+                && !(m_settings.recursive && QFileInfo(inputFile).absoluteFilePath().startsWith(outputRoot))
+                && QFileInfo(inputFile).absoluteFilePath() != ChecksumManifest::filePath(m_settings.outputPath)
+                && !PackWriter::isPackFile(inputFile)
+                && !offerInputFile(inputFile)) {
+                break;
+            }
+        }
+    }
+
+    enumerationDone = true;
+    inputQueue.close();
+
+    const int totalCount = discoveredCount.loadRelaxed();
+    if (fullScan && !m_stopRequested) {
+        m_lastDiscoveredCount = totalCount;
+        if (m_index) {
+            m_index->pruneUnseen();
         }
+    }
+
+    if (skippedCount.loadRelaxed() > 0) {
+        emit statusUpdated(QString("Пропущено без изменений: %1").arg(skippedCount.loadRelaxed()));
+    }
+    if (totalCount > 0) {
+        emit statusUpdated(QString("Найдено файлов: %1").arg(totalCount));
+    }
+
+    workers.waitForDone();
+
+    {
+        QMutexLocker locker(&reporterMutex);
+        reporterDone = true;
+        reporterWake.wakeAll();
+    }
+    reporter.join();
 
-        int progress = (processedCount * 100) / totalCount;
-        emit progressUpdated(progress);
+    {
+        QMutexLocker locker(&m_currentFileMutex);
+        m_currentFile.clear();
     }
+    emit currentFileChanged(QString());
 
-    if (!m_stopRequested) {
+    m_metrics.setInputQueueDepth(0);
+    publishMetrics();
+
+    if (identityKey && totalCount > 0) {
+        emit statusUpdated(QString("Копирование: reflink %1, copy_file_range %2, чтение и запись %3")
+                               .arg(m_clonedCount.load()).arg(m_rangeCopiedCount.load())
+                               .arg(m_plainCopiedCount.load()));
+    }
+
+    finishRun();
+
+    if (m_stopRequested) {
+        emit statusUpdated("Обработка прервана пользователем");
+    } else if (totalCount == 0) {
+        emit statusUpdated("Файлы для обработки не найдены");
+    } else {
         emit statusUpdated(QString("Обработка завершена. Обработано файлов: %1 из %2")
-                               .arg(processedCount).arg(totalCount));
+                               .arg(processedCount.loadRelaxed()).arg(totalCount));
         emit progressUpdated(100);
     }
+
+    emit runCompleted(processedCount.loadRelaxed(), skippedCount.loadRelaxed(), totalCount);
 }
 
-bool FileProcessor::processFile(const QString &inputFilePath, const QString &outputFilePath)
+// Each output is read once: its own hash is taken from the bytes as read, and when the
+// key is known the same buffer is XORed back to check the recorded input hash as well.
+void FileProcessor::runVerification()
 {
-    QFile inputFile(inputFilePath);
-    QFile outputFile(outputFilePath);
+    const QString manifestPath = ChecksumManifest::filePath(m_settings.outputPath);
+    ChecksumManifest manifest(m_settings.outputPath, Checksum::NoChecksum);
+    if (!QFile::exists(manifestPath) || !manifest.load()) {
+        emit errorOccurred("Файл контрольных сумм не найден или поврежден: " + manifestPath);
+        emit runCompleted(0, 0, 0);
+        return;
+    }
 
-    if (!inputFile.open(QIODevice::ReadOnly)) {
-        return false;
+    const QMap<QString, ChecksumManifest::Entry> entries = manifest.entries();
+    const QStringList relativePaths = entries.keys();
+    const int totalCount = relativePaths.size();
+    const Checksum::Algorithm algorithm = manifest.algorithm();
+    const bool checkInputs = !m_settings.key.isNull();
+    const QDir outputDir(manifest.rootPath());
+
+    emit statusUpdated(QString("Проверка %1 файлов (%2)%3")
+                           .arg(totalCount)
+                           .arg(Checksum::algorithmName(algorithm))
+                           .arg(checkInputs ? ", включая исходные файлы" : ""));
+
+    const int workerCount = qMax(1, m_settings.workerCount > 0 ? m_settings.workerCount : QThread::idealThreadCount());
+    const qint64 bufferSize = m_settings.bufferSize > 0 ? m_settings.bufferSize : BUFFER_SIZE;
+    QAtomicInt nextIndex(0);
+    QAtomicInt finishedCount(0);
+    QAtomicInt matchedCount(0);
+
+    QThreadPool workers;
+    workers.setMaxThreadCount(workerCount);
+
+    for (int i = 0; i < workerCount; ++i) {
+        workers.start([&]() {
+            std::vector<char> buffer(bufferSize);
+
+            int index;
+            while (!m_stopRequested && (index = nextIndex.fetchAndAddRelaxed(1)) < totalCount) {
+                const QString &relativePath = relativePaths.at(index);
+                const ChecksumManifest::Entry entry = entries.value(relativePath);
+                const QString filePath = outputDir.absoluteFilePath(relativePath);
+
+                FileChecksums checksums(algorithm, checkInputs && !entry.inputChecksum.isEmpty());
+                QString error;
+
+                QFile file(filePath);
+                if (!file.open(QIODevice::ReadOnly | QIODevice::Unbuffered)) {
+                    error = "Файл не найден: %1";
+                } else if (file.size() != entry.size) {
+                    error = "Размер файла не совпадает: %1";
+                } else {
+                    qint64 offset = 0;
+                    while (!m_stopRequested) {
+                        const qint64 bytesRead = file.read(buffer.data(), bufferSize);
+                        if (bytesRead < 0) {
+                            error = "Не удалось прочитать файл: %1";
+                            break;
+                        }
+                        if (bytesRead == 0) {
+                            break;
+                        }
+
+                        checksums.output.update(buffer.data(), bytesRead);
+                        if (checksums.input.isEnabled()) {
+                            xorProcessBuffer(buffer.data(), bytesRead, offset);
+                            checksums.input.update(buffer.data(), bytesRead);
+                        }
+                        offset += bytesRead;
+                    }
+
+                    if (error.isEmpty() && !m_stopRequested) {
+                        if (checksums.output.toHex() != entry.outputChecksum) {
+                            error = "Контрольная сумма не совпадает: %1";
+                        } else if (checksums.input.isEnabled() && checksums.input.toHex() != entry.inputChecksum) {
+                            error = "Контрольная сумма исходного файла не совпадает: %1";
+                        }
+                    }
+                }
+
+                if (m_stopRequested) {
+                    break;
+                }
+                if (error.isEmpty()) {
+                    matchedCount.ref();
+                } else {
+                    emit errorOccurred(error.arg(filePath));
+                }
+                finishedCount.ref();
+            }
+        });
     }
 
-    if (!outputFile.open(QIODevice::WriteOnly)) {
-        inputFile.close();
-        return false;
+    while (!workers.waitForDone(REPORT_INTERVAL_MS)) {
+        emit progressUpdated(totalCount > 0 ? int(qint64(finishedCount.loadRelaxed()) * 100 / totalCount) : 0);
     }
 
-    qint64 totalSize = inputFile.size();
-    qint64 processedSize = 0;
+    if (m_stopRequested) {
+        emit statusUpdated("Проверка прервана пользователем");
+    } else {
+        emit statusUpdated(QString("Проверка завершена: совпало %1 из %2").arg(matchedCount.loadRelaxed()).arg(totalCount));
+        emit progressUpdated(100);
+    }
 
-    char *buffer = new char[BUFFER_SIZE];
+    emit runCompleted(matchedCount.loadRelaxed(), 0, totalCount);
+}
 
-    while (!inputFile.atEnd() && !m_stopRequested) {
-        qint64 bytesRead = inputFile.read(buffer, BUFFER_SIZE);
-        if (bytesRead <= 0) {
-            break;
+bool FileProcessor::prepareRun()
+{
+    if (m_settings.key.isNull()) {
+        emit errorOccurred("Не задан ключ XOR");
+        return false;
+    }
+
+    m_outputDir = QDir(m_settings.outputPath);
+    if (!m_outputDir.exists()) {
+        if (!m_outputDir.mkpath(".")) {
+            emit errorOccurred("Не удалось создать выходную папку: " + m_settings.outputPath);
+            return false;
         }
+    }
 
-        xorProcessBuffer(buffer, bytesRead);
+    m_metrics.reset();
 
-        qint64 bytesWritten = outputFile.write(buffer, bytesRead);
-        if (bytesWritten != bytesRead) {
-            delete[] buffer;
-            inputFile.close();
-            outputFile.close();
-            return false;
+    const bool identityKey = m_settings.key.kind() == XorKey::IdentityKey;
+    m_clonedCount = 0;
+    m_rangeCopiedCount = 0;
+    m_plainCopiedCount = 0;
+    if (identityKey) {
+        emit statusUpdated("Нулевой ключ: файлы копируются без преобразования");
+    } else {
+        emit statusUpdated(QString("Ядро XOR: %1%2")
+                               .arg(XorKernel::variantName(XorKernel::bestVariant()))
+                               .arg(m_settings.key.kind() == XorKey::UniformKey ? ", ключ из одного байта" : ""));
+    }
+
+    m_index.reset();
+    {
+        QMutexLocker locker(&m_indexStampsMutex);
+        m_indexStamps.clear();
+    }
+
+    if (m_settings.skipUnchanged) {
+        const QString indexPath = m_settings.indexPath.isEmpty()
+            ? ProcessedIndex::defaultFilePath(m_settings.inputPath, m_settings.outputPath)
+            : m_settings.indexPath;
+
+        m_index.reset(new ProcessedIndex(indexPath, m_settings.key.fingerprint(), m_settings.indexContentHash));
+        if (!m_index->load()) {
+            emit statusUpdated("Индекс обработанных файлов поврежден и будет создан заново");
         }
+    }
 
-        processedSize += bytesRead;
+    m_checkpoint.reset();
+    if (m_settings.resumable) {
+        m_checkpoint.reset(new JobCheckpoint(JobCheckpoint::defaultFilePath(m_settings.inputPath, m_settings.outputPath),
+                                             m_settings.key.fingerprint()));
+        if (!m_checkpoint->load()) {
+            emit statusUpdated("Контрольная точка повреждена, обработка начнется заново");
+        } else if (!m_checkpoint->isEmpty()) {
+            emit statusUpdated("Возобновление прерванной обработки");
+        }
+    }
 
-        if (totalSize > 10 * 1024 * 1024) {
-            int fileProgress = (processedSize * 100) / totalSize;
+    // Packed entries carry a CRC32C in the segment index, so they need no manifest.
+    const bool packed = m_settings.outputFormat == FileProcessorSettings::PackedSegments;
+    m_manifest.reset();
+    if (m_settings.checksumAlgorithm != Checksum::NoChecksum && !packed) {
+        m_manifest.reset(new ChecksumManifest(m_outputDir.absolutePath(), m_settings.checksumAlgorithm));
+        if (!m_manifest->load()) {
+            emit statusUpdated("Файл контрольных сумм поврежден и будет создан заново");
+        }
+        emit statusUpdated(QString("Контрольные суммы: %1%2")
+                               .arg(Checksum::algorithmName(m_settings.checksumAlgorithm))
+                               .arg(m_settings.checksumAlgorithm == Checksum::Crc32c && Checksum::hasHardwareCrc32c()
+                                        ? ", аппаратный CRC" : ""));
+        // Hashes are computed front to back, so large files skip the ranged path and
+        // with it the progress recorded inside them.
+        if (m_settings.resumable && m_settings.largeFileThreshold > 0) {
+            emit statusUpdated("С контрольными суммами большие файлы после прерывания обрабатываются заново");
         }
     }
 
-    delete[] buffer;
-    inputFile.close();
-    outputFile.close();
+    m_packWriter.reset();
+    if (packed) {
+        m_packWriter.reset(new PackWriter(m_outputDir.absolutePath(), m_settings.packSegmentSize));
+        if (!m_packWriter->open()) {
+            emit errorOccurred("Нет доступа на запись к папке упакованного вывода: " + m_settings.outputPath);
+            m_packWriter.reset();
+            m_manifest.reset();
+            m_checkpoint.reset();
+            m_index.reset();
+            return false;
+        }
+        emit statusUpdated("Упакованный вывод: " + QFileInfo(m_packWriter->segmentPath()).fileName());
+    }
 
-    return !m_stopRequested;
+    m_outputNames.clear();
+
+    qint64 bufferSize = m_settings.bufferSize;
+    if (bufferSize <= 0) {
+        BufferTuner tuner(BUFFER_SIZE);
+        bufferSize = qMax(tuner.bufferSizeFor(m_settings.inputPath), tuner.bufferSizeFor(m_outputDir.absolutePath()));
+
+        // The device decides the upper bound; a sample of the inputs may show that far less will do.
+        QVector<qint64> fileSizes;
+        if (!m_inputFiles.isEmpty()) {
+            for (int i = 0; i < m_inputFiles.size() && i < BUFFER_SIZE_SAMPLE; ++i) {
+                fileSizes.append(QFileInfo(m_inputFiles.at(i)).size());
+            }
+        } else {
+            enumerateInputFiles([&](const QString &inputFile) {
+                fileSizes.append(QFileInfo(inputFile).size());
+                return fileSizes.size() < BUFFER_SIZE_SAMPLE;
+            });
+        }
+        m_chunkSize = bufferSize;
+        bufferSize = BufferTuner::fitToFileSizes(bufferSize, fileSizes);
+        emit statusUpdated(QString("Размер буфера: %1 КиБ").arg(bufferSize / 1024));
+    }
+    m_bufferSize = bufferSize;
+    if (m_settings.bufferSize > 0) {
+        m_chunkSize = bufferSize;
+    }
+    return true;
 }
 
-QString FileProcessor::generateUniqueFileName(const QString &basePath)
+// Everything a run leaves behind once its files are done: inputs waiting for a group
+// commit, the pack segment, the index, the manifest and the checkpoint.
+void FileProcessor::finishRun()
 {
-    QFileInfo fileInfo(basePath);
-    QString baseName = fileInfo.completeBaseName();
-    QString extension = fileInfo.suffix();
-    QString dirPath = fileInfo.absolutePath();
+    commitPendingInputFiles();
+    if (m_packWriter) {
+        if (!m_packWriter->close()) {
+            emit errorOccurred("Не удалось сохранить сегмент упакованного вывода: " + m_packWriter->segmentPath());
+        }
+        m_packWriter.reset();
+    }
 
-    int counter = 1;
-    QString newFileName;
+    if (m_index && !m_index->save()) {
+        emit errorOccurred("Не удалось сохранить индекс обработанных файлов");
+    }
 
-    do {
-        if (extension.isEmpty()) {
-            newFileName = QString("%1_%2").arg(baseName).arg(counter);
+    if (m_manifest) {
+        if (!m_manifest->save()) {
+            emit errorOccurred("Не удалось сохранить файл контрольных сумм");
+        }
+        m_manifest.reset();
+    }
+
+    // A finished run leaves nothing to resume; a stopped one keeps its checkpoint.
+    if (m_checkpoint) {
+        if (m_stopRequested) {
+            if (!m_checkpoint->save()) {
+                emit errorOccurred("Не удалось сохранить контрольную точку");
+            }
         } else {
-            newFileName = QString("%1_%2.%3").arg(baseName).arg(counter).arg(extension);
+            m_checkpoint->remove();
+        }
+        m_checkpoint.reset();
+    }
+}
+
+bool FileProcessor::acceptInputFile(const QString &inputFile)
+{
+    // The index is asked first, so that it counts the file as seen and pruneUnseen
+    // keeps its entry even when the checkpoint skips it.
+    ProcessedIndex::Stamp stamp;
+    if (m_index && m_index->isUnchanged(inputFile, &stamp)) {
+        return false;
+    }
+
+    // Finished before an interruption, possibly without the index being saved since.
+    if (m_checkpoint && m_checkpoint->isCompleted(inputFile)) {
+        if (m_index && stamp.size >= 0) {
+            m_index->markProcessed(inputFile, stamp);
         }
-        counter++;
-    } while (QFile::exists(QDir(dirPath).absoluteFilePath(newFileName)));
+        return false;
+    }
+
+    if (m_index) {
+        QMutexLocker locker(&m_indexStampsMutex);
+        m_indexStamps.insert(inputFile, stamp);
+    }
+
+    return true;
+}
 
-    return QDir(dirPath).absoluteFilePath(newFileName);
+bool FileProcessor::beginExternalRun()
+{
+    m_stopRequested = false;
+    return prepareRun();
 }
 
-QStringList FileProcessor::findInputFiles()
+bool FileProcessor::processExternalFile(const QString &inputFile, BufferPool &pool)
 {
-    QDir inputDir(m_settings.inputPath);
+    m_metrics.adjustActiveWorkers(1);
+    QElapsedTimer fileTimer;
+    fileTimer.start();
+    const bool ok = processInputFile(inputFile, m_outputDir, pool);
+    reportFile(inputFile, fileTimer.nsecsElapsed(), ok);
+    m_metrics.adjustActiveWorkers(-1);
+    return ok;
+}
 
-    QStringList masks = m_settings.fileMask.split(';', Qt::SkipEmptyParts);
-    for (QString &mask : masks) {
-        mask = mask.trimmed();
+// The scheduler ends a job only once it has enumerated the job's whole input tree,
+// so a run that was not stopped has seen every file.
+void FileProcessor::endExternalRun()
+{
+    if (m_index && !m_stopRequested) {
+        m_index->pruneUnseen();
     }
+    setCurrentFile(QString());
+    publishMetrics();
+    finishRun();
+}
 
-    if (masks.isEmpty()) {
-        masks << "*";
+void FileProcessor::setCurrentFile(const QString &fileName)
+{
+    QMutexLocker locker(&m_currentFileMutex);
+    m_currentFile = fileName;
+}
+
+void FileProcessor::reportFile(const QString &inputFile, qint64 elapsedNs, bool ok)
+{
+    m_metrics.recordFile(elapsedNs, ok);
+    emit fileProcessed(inputFile, elapsedNs, ok);
+}
+
+void FileProcessor::publishMetrics()
+{
+    const ProcessingMetrics::Snapshot snapshot = m_metrics.snapshot();
+    emit metricsUpdated(snapshot);
+
+    if (m_settings.metricsPath.isEmpty()) {
+        return;
     }
 
-    inputDir.setNameFilters(masks);
-    inputDir.setFilter(QDir::Files | QDir::Readable);
+    // Written through a temporary file and renamed so a scraper never sees a partial file.
+    QSaveFile file(m_settings.metricsPath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return;
+    }
+    file.write(m_settings.metricsFormat == FileProcessorSettings::PrometheusMetrics
+                   ? ProcessingMetrics::toPrometheus(snapshot)
+                   : ProcessingMetrics::toJson(snapshot));
+    file.commit();
+}
 
-    QStringList files;
-    QFileInfoList fileInfoList = inputDir.entryInfoList();
+QString FileProcessor::relativeOutputPath(const QString &inputFile) const
+{
+    QString relativePath = QDir(m_settings.inputPath).relativeFilePath(inputFile);
+    if (relativePath.startsWith("..") || QDir::isAbsolutePath(relativePath)) {
+        relativePath = QFileInfo(inputFile).fileName();
+    }
+    return relativePath;
+}
 
-    for (const QFileInfo &fileInfo : fileInfoList) {
-        files << fileInfo.absoluteFilePath();
+QString FileProcessor::outputPathFor(const QString &inputFile, const QDir &outputDir) const
+{
+    const QString relativePath = relativeOutputPath(inputFile);
+    const QString outputFilePath = outputDir.absoluteFilePath(relativePath);
+    if (relativePath.contains('/')) {
+        QDir().mkpath(QFileInfo(outputFilePath).absolutePath());
     }
 
-    return files;
+    return outputFilePath;
 }
 
-void FileProcessor::xorProcessBuffer(char *buffer, qint64 size)
+bool FileProcessor::processInputFile(const QString &inputFile, const QDir &outputDir, BufferPool &pool)
 {
-    union {
-        quint64 value;
-        char bytes[8];
-    } xorKey;
+    // An interrupted in-place pass still has to finish as a separate file.
+    if (m_packWriter && !QFile::exists(inputFile + JOURNAL_SUFFIX)) {
+        return processInputFilePacked(inputFile, pool);
+    }
 
-    xorKey.value = m_settings.xorValue;
+    QFileInfo fileInfo(inputFile);
+    QString outputFilePath = reserveOutputFilePath(inputFile, outputPathFor(inputFile, outputDir));
 
-    for (qint64 i = 0; i < size; ++i) {
-        buffer[i] ^= xorKey.bytes[i % 8];
+    setCurrentFile(fileInfo.fileName());
+
+    if (shouldTransformInPlace(fileInfo, outputDir)) {
+        return processInputFileInPlace(inputFile, outputFilePath);
     }
+
+    // The output is written under a temporary name; a stopped file keeps it only when
+    // the checkpoint can continue it.
+    const QString partFilePath = outputFilePath + PART_SUFFIX;
+    FileChecksums checksums(m_settings.checksumAlgorithm, m_settings.checksumInput);
+    if (!processFile(inputFile, partFilePath, pool, m_manifest ? &checksums : nullptr)) {
+        JobCheckpoint::FileState state;
+        if (!m_stopRequested || !m_checkpoint || !m_checkpoint->fileState(inputFile, &state)) {
+            QFile::remove(partFilePath);
+            if (m_checkpoint) {
+                m_checkpoint->clearFileState(inputFile);
+            }
+        }
+        releaseOutputFilePath(outputFilePath);
+        if (!m_stopRequested) {
+            emit errorOccurred(QString("Не удалось обработать файл: %1").arg(inputFile));
+        }
+        return false;
+    }
+
+    if (!publishOutputFile(partFilePath, outputFilePath)) {
+        QFile::remove(partFilePath);
+        releaseOutputFilePath(outputFilePath);
+        emit errorOccurred(QString("Не удалось переименовать временный файл: %1").arg(partFilePath));
+        return false;
+    }
+    if (m_checkpoint) {
+        m_checkpoint->clearFileState(inputFile);
+    }
+    if (m_manifest) {
+        m_manifest->insert(outputFilePath, checksums.entry(QFileInfo(outputFilePath).size()));
+    }
+
+    completeInputFile(inputFile, outputFilePath);
+    return true;
+}
+
+// A file that fits one pool buffer is read and transformed before the writer is locked,
+// so workers only serialize on the copy into the segment buffer. Larger files are
+// streamed into the segment under the lock.
+bool FileProcessor::processInputFilePacked(const QString &inputFile, BufferPool &pool)
+{
+    setCurrentFile(QFileInfo(inputFile).fileName());
+
+    StageClock clock(m_metrics);
+
+    QFile file(inputFile);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Unbuffered)) {
+        emit errorOccurred(QString("Не удалось обработать файл: %1").arg(inputFile));
+        return false;
+    }
+    clock.lap(ProcessingMetrics::OpenStage);
+
+    const qint64 size = file.size();
+    const QString entryName = relativeOutputPath(inputFile);
+    char *buffer = pool.acquire();
+    bool ok;
+
+    if (size <= pool.bufferSize()) {
+        ok = size == 0 || file.read(buffer, size) == size;
+        clock.lap(ProcessingMetrics::ReadStage);
+        if (ok && size > 0) {
+            xorProcessBuffer(buffer, size, 0);
+            clock.lap(ProcessingMetrics::TransformStage);
+        }
+        ok = ok && !m_stopRequested && m_packWriter->append(entryName, buffer, size);
+        clock.lap(ProcessingMetrics::WriteStage);
+    } else {
+        const bool begun = m_packWriter->beginEntry(entryName, size);
+        ok = begun;
+        for (qint64 offset = 0; ok && offset < size && !m_stopRequested; offset += pool.bufferSize()) {
+            const qint64 length = qMin(pool.bufferSize(), size - offset);
+            ok = file.read(buffer, length) == length;
+            clock.lap(ProcessingMetrics::ReadStage);
+            if (ok) {
+                xorProcessBuffer(buffer, length, offset);
+                clock.lap(ProcessingMetrics::TransformStage);
+                ok = m_packWriter->writeEntryData(buffer, length);
+                clock.lap(ProcessingMetrics::WriteStage);
+            }
+        }
+        if (begun && ok && !m_stopRequested) {
+            ok = m_packWriter->finishEntry();
+        } else if (begun) {
+            m_packWriter->abortEntry();
+            ok = false;
+        }
+    }
+    pool.release(buffer);
+
+    if (!ok) {
+        if (!m_stopRequested) {
+            emit errorOccurred(QString("Не удалось обработать файл: %1").arg(inputFile));
+        }
+        return false;
+    }
+
+    m_metrics.addBytes(size);
+    completeInputFile(inputFile, m_packWriter->segmentPath());
+    return true;
+}
+
+int FileProcessor::processInputBatch(const QStringList &inputFiles, const QDir &outputDir, UringEngine &engine)
+{
+    int processedCount = 0;
+    QVector<UringEngine::Job> jobs;
+
+    // Files in a batch complete together, so each one is reported with the batch latency.
+    QElapsedTimer batchTimer;
+    batchTimer.start();
+
+    for (const QString &inputFile : inputFiles) {
+        QFileInfo fileInfo(inputFile);
+        QString outputFilePath = reserveOutputFilePath(inputFile, outputPathFor(inputFile, outputDir));
+
+        setCurrentFile(fileInfo.fileName());
+
+        if (shouldTransformInPlace(fileInfo, outputDir)) {
+            const bool ok = processInputFileInPlace(inputFile, outputFilePath);
+            reportFile(inputFile, batchTimer.nsecsElapsed(), ok);
+            if (ok) {
+                processedCount++;
+            }
+            continue;
+        }
+
+        UringEngine::Job job;
+        job.inputPath = inputFile;
+        job.outputPath = outputFilePath + PART_SUFFIX;
+        jobs.append(job);
+    }
+
+    engine.process(jobs, m_stopRequested);
+
+    for (const UringEngine::Job &job : jobs) {
+        const QString outputFilePath = job.outputPath.chopped(qstrlen(PART_SUFFIX));
+        const bool ok = job.ok && publishOutputFile(job.outputPath, outputFilePath);
+        reportFile(job.inputPath, batchTimer.nsecsElapsed(), ok);
+
+        if (!ok) {
+            QFile::remove(job.outputPath);
+            releaseOutputFilePath(outputFilePath);
+            if (!m_stopRequested) {
+                emit errorOccurred(QString("Не удалось обработать файл: %1").arg(job.inputPath));
+            }
+            continue;
+        }
+
+        m_metrics.addBytes(QFileInfo(outputFilePath).size());
+        completeInputFile(job.inputPath, outputFilePath);
+        processedCount++;
+    }
+
+    return processedCount;
+}
+
+#ifdef Q_OS_UNIX
+int FileProcessor::processSmallFileBatch(const QString &firstFile, const std::function<bool(QString *)> &nextFile,
+                                         const QDir &outputDir, BufferPool &pool, std::vector<char> &arena,
+                                         int *handledCount)
+{
+    struct SmallFile
+    {
+        QString inputPath;
+        qint64 size;
+        qint64 offset;
+        bool ok;
+        QString outputPath;
+        ChecksumManifest::Entry checksums;
+    };
+
+    std::vector<SmallFile> files;
+    files.reserve(SMALL_FILE_BATCH);
+
+    QElapsedTimer batchTimer;
+    batchTimer.start();
+    StageClock clock(m_metrics);
+
+    // Each input is opened, read whole with a single pread into its slice of the arena
+    // and closed again, so a batch holds one descriptor at a time. The first file that
+    // is too large for the arena, not a regular file, has an in-place journal or finds
+    // the process out of descriptors ends the batch and goes through the regular path.
+    QString regularFile;
+    QString candidate = firstFile;
+    qint64 arenaUsed = 0;
+    do {
+        if (QFile::exists(candidate + JOURNAL_SUFFIX)) {
+            regularFile = candidate;
+            break;
+        }
+
+        const int fd = ::open(QFile::encodeName(candidate).constData(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EMFILE || errno == ENFILE) {
+                regularFile = candidate;
+                break;
+            }
+            files.push_back({ candidate, 0, arenaUsed, false, QString(), ChecksumManifest::Entry() });
+            continue;
+        }
+
+        struct stat info;
+        if (::fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size > SMALL_FILE_LIMIT
+            || arenaUsed + info.st_size > qint64(arena.size())) {
+            ::close(fd);
+            regularFile = candidate;
+            break;
+        }
+        clock.lap(ProcessingMetrics::OpenStage);
+
+        SmallFile file = { candidate, qint64(info.st_size), arenaUsed, true, QString(), ChecksumManifest::Entry() };
+        if (file.size > 0 && preadFully(fd, arena.data() + file.offset, file.size, 0) != file.size) {
+            file.ok = false;
+        }
+        ::close(fd);
+        clock.lap(ProcessingMetrics::ReadStage);
+
+        files.push_back(file);
+        arenaUsed += file.size;
+    } while (int(files.size()) < SMALL_FILE_BATCH && !m_stopRequested && nextFile(&candidate));
+
+    if (!files.empty()) {
+        setCurrentFile(files.size() > 1
+                           ? QString("%1 (+%2)").arg(QFileInfo(files.front().inputPath).fileName()).arg(files.size() - 1)
+                           : QFileInfo(files.front().inputPath).fileName());
+    }
+
+    for (SmallFile &file : files) {
+        if (!file.ok) {
+            continue;
+        }
+
+        char *data = arena.data() + file.offset;
+        FileChecksums checksums(m_settings.checksumAlgorithm, m_settings.checksumInput);
+        if (m_manifest) {
+            checksums.input.update(data, file.size);
+        }
+        if (file.size > 0) {
+            xorProcessBuffer(data, file.size, 0);
+        }
+        if (m_manifest) {
+            checksums.output.update(data, file.size);
+            file.checksums = checksums.entry(file.size);
+        }
+    }
+    clock.lap(ProcessingMetrics::TransformStage);
+
+    const bool dropCache = m_settings.cachePolicy == FileProcessorSettings::DropCache;
+    for (SmallFile &file : files) {
+        if (!file.ok || m_stopRequested) {
+            file.ok = false;
+            continue;
+        }
+
+        file.outputPath = reserveOutputFilePath(file.inputPath, outputPathFor(file.inputPath, outputDir));
+        const QString partFilePath = file.outputPath + PART_SUFFIX;
+        const int fd = ::open(QFile::encodeName(partFilePath).constData(),
+                              O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+        if (fd < 0) {
+            file.ok = false;
+            continue;
+        }
+
+        file.ok = pwriteFully(fd, arena.data() + file.offset, file.size, 0);
+        if (file.ok && dropCache) {
+            dropWrittenRange(fd, 0, file.size);
+        }
+        if (::close(fd) != 0) {
+            file.ok = false;
+        }
+        if (!file.ok || !publishOutputFile(partFilePath, file.outputPath)) {
+            QFile::remove(partFilePath);
+            releaseOutputFilePath(file.outputPath);
+            file.ok = false;
+        }
+    }
+    clock.lap(ProcessingMetrics::WriteStage);
+
+    int processedCount = 0;
+    const qint64 elapsedNs = batchTimer.nsecsElapsed();
+    for (const SmallFile &file : files) {
+        reportFile(file.inputPath, elapsedNs, file.ok);
+
+        if (!file.ok) {
+            if (!m_stopRequested) {
+                emit errorOccurred(QString("Не удалось обработать файл: %1").arg(file.inputPath));
+            }
+            continue;
+        }
+
+        m_metrics.addBytes(file.size);
+        if (m_manifest) {
+            m_manifest->insert(file.outputPath, file.checksums);
+        }
+        completeInputFile(file.inputPath, file.outputPath);
+        processedCount++;
+    }
+    *handledCount = int(files.size());
+
+    if (!regularFile.isEmpty()) {
+        QElapsedTimer fileTimer;
+        fileTimer.start();
+        const bool ok = processInputFile(regularFile, outputDir, pool);
+        reportFile(regularFile, fileTimer.nsecsElapsed(), ok);
+        if (ok) {
+            processedCount++;
+        }
+        ++*handledCount;
+    }
+
+    return processedCount;
+}
+#endif
+
+bool FileProcessor::shouldTransformInPlace(const QFileInfo &fileInfo, const QDir &outputDir) const
+{
+    if (QFile::exists(fileInfo.absoluteFilePath() + JOURNAL_SUFFIX)) {
+        return true;
+    }
+
+    return m_settings.deleteInputFiles && m_settings.transformInPlace
+        && QStorageInfo(fileInfo.absolutePath()) == QStorageInfo(outputDir.absolutePath());
+}
+
+void FileProcessor::completeInputFile(const QString &inputFile, const QString &outputFilePath, bool inputMoved)
+{
+    const bool deleteInput = m_settings.deleteInputFiles && !inputMoved;
+
+    // A packed entry may still sit in the writer's buffer, so its input is always
+    // released in a group, after the segment has been flushed.
+    switch (m_packWriter ? FileProcessorSettings::GroupCommit : m_settings.durability) {
+    case FileProcessorSettings::SyncEachFile:
+        if (!syncPath(outputFilePath, true)
+            || ((m_settings.deleteInputFiles || inputMoved)
+                && !syncPath(QFileInfo(outputFilePath).absolutePath(), false))) {
+            emit errorOccurred(QString("Не удалось сохранить на диск: %1").arg(outputFilePath));
+            return;
+        }
+        break;
+    case FileProcessorSettings::GroupCommit: {
+        QMutexLocker locker(&m_pendingCommitMutex);
+        m_pendingCommit.append(PendingInput{ inputFile, deleteInput });
+        const bool commitNow = m_pendingCommit.size() >= GROUP_COMMIT_SIZE;
+        locker.unlock();
+        if (commitNow) {
+            commitPendingInputFiles();
+        }
+        return;
+    }
+    default:
+        break;
+    }
+
+    finishInputFile(inputFile, deleteInput);
+}
+
+// One syncfs on the output filesystem, or one flush of the pack segment, makes every
+// output written so far durable, so the inputs of the whole group can be released afterwards.
+void FileProcessor::commitPendingInputFiles()
+{
+    QVector<PendingInput> inputFiles;
+    {
+        QMutexLocker locker(&m_pendingCommitMutex);
+        inputFiles.swap(m_pendingCommit);
+    }
+
+    if (inputFiles.isEmpty()) {
+        return;
+    }
+
+    const bool synced = m_packWriter
+        ? m_packWriter->flush(m_settings.durability != FileProcessorSettings::NoSync)
+        : syncFileSystem(m_settings.outputPath);
+    if (!synced) {
+        emit errorOccurred(QString("Не удалось сохранить на диск группу из %1 файлов, входные файлы сохранены")
+                               .arg(inputFiles.size()));
+        return;
+    }
+
+    for (const PendingInput &pending : inputFiles) {
+        finishInputFile(pending.inputFile, pending.deleteInput);
+    }
+}
+
+void FileProcessor::finishInputFile(const QString &inputFile, bool deleteInput)
+{
+    if (m_index) {
+        QMutexLocker locker(&m_indexStampsMutex);
+        const ProcessedIndex::Stamp stamp = m_indexStamps.take(inputFile);
+        locker.unlock();
+        m_index->markProcessed(inputFile, stamp);
+    }
+
+    if (deleteInput) {
+        if (!QFile::remove(inputFile)) {
+            emit errorOccurred(QString("Не удалось удалить входной файл: %1").arg(inputFile));
+        }
+    }
+
+    if (m_checkpoint) {
+        m_checkpoint->markCompleted(inputFile);
+    }
+}
+
+bool FileProcessor::processInputFileInPlace(const QString &inputFile, const QString &outputFilePath)
+{
+    // A resumed pass has lost the hashes of the part done before the interruption.
+    InPlaceJournal journal;
+    const bool resuming = loadJournal(inputFile + JOURNAL_SUFFIX, &journal) && journalMatchesFile(journal, inputFile);
+    const bool hashing = m_manifest && !resuming;
+    FileChecksums checksums(m_settings.checksumAlgorithm, m_settings.checksumInput);
+
+    if (!transformInPlace(inputFile, hashing ? &checksums : nullptr)) {
+        releaseOutputFilePath(outputFilePath);
+        if (!m_stopRequested) {
+            emit errorOccurred(QString("Не удалось обработать файл: %1").arg(inputFile));
+        }
+        return false;
+    }
+
+    const QString journalPath = inputFile + JOURNAL_SUFFIX;
+
+    if (QFileInfo(outputFilePath).absoluteFilePath() != QFileInfo(inputFile).absoluteFilePath()) {
+        // QFile::rename copies across volumes, which an interrupted pass may need. It
+        // never replaces an existing file, so a reserved name stays safe without overwriting.
+        if (m_settings.overwriteOutput && QFile::exists(outputFilePath)) {
+            QFile::remove(outputFilePath);
+        }
+        const bool moved = QFile::rename(inputFile, outputFilePath);
+        releaseOutputFilePath(outputFilePath);
+        if (!moved) {
+            emit errorOccurred(QString("Не удалось переместить файл: %1").arg(inputFile));
+            return false;
+        }
+    }
+
+    QFile::remove(journalPath);
+    if (hashing) {
+        m_manifest->insert(outputFilePath, checksums.entry(QFileInfo(outputFilePath).size()));
+    } else if (m_manifest) {
+        // No hash for this output: an entry left from an earlier run would fail verification.
+        m_manifest->remove(outputFilePath);
+    }
+
+    completeInputFile(inputFile, outputFilePath, true);
+    return true;
+}
+
+bool FileProcessor::transformInPlace(const QString &filePath, FileChecksums *checksums)
+{
+    const QString journalPath = filePath + JOURNAL_SUFFIX;
+
+    // An identity key leaves the file as it is; only a pass interrupted under another
+    // key still has to be finished, and the journal check below rejects that.
+    if (m_settings.key.kind() == XorKey::IdentityKey && !QFile::exists(journalPath) && !checksums) {
+        return true;
+    }
+
+    StageClock clock(m_metrics);
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadWrite)) {
+        return false;
+    }
+    clock.lap(ProcessingMetrics::OpenStage);
+
+    const qint64 size = file.size();
+    std::vector<char> buffer(IN_PLACE_STEP_SIZE);
+
+    InPlaceJournal journal;
+    journal.xorValue = m_settings.key.fingerprint();
+    ProcessedIndex::Stamp identity;
+    if (ProcessedIndex::stampOf(filePath, false, &identity)) {
+        journal.device = identity.device;
+        journal.fileId = identity.fileId;
+    }
+    journal.size = size;
+
+    InPlaceJournal saved;
+    if (QFile::exists(journalPath) && loadJournal(journalPath, &saved) && !journalMatchesFile(saved, filePath)) {
+        QFile::remove(journalPath);
+        emit statusUpdated(QString("Удален журнал обработки другого файла: %1").arg(journalPath));
+    }
+
+    if (QFile::exists(journalPath)) {
+        if (!loadJournal(journalPath, &saved) || saved.xorValue != m_settings.key.fingerprint()) {
+            emit errorOccurred(QString("Журнал обработки поврежден или создан с другим ключом: %1").arg(journalPath));
+            return false;
+        }
+        journal = saved;
+
+        if (journal.pendingLength > 0) {
+            if (!file.seek(journal.offset)
+                || file.read(buffer.data(), journal.pendingLength) != journal.pendingLength) {
+                return false;
+            }
+
+            if (hashBytes(buffer.data(), journal.pendingLength) != journal.pendingHash) {
+                xorProcessBuffer(buffer.data(), journal.pendingLength, journal.offset);
+                if (hashBytes(buffer.data(), journal.pendingLength) != journal.pendingHash) {
+                    emit errorOccurred(QString("Прерванная запись не может быть восстановлена: %1").arg(filePath));
+                    return false;
+                }
+                journal.offset += journal.pendingLength;
+            }
+            journal.pendingLength = 0;
+        }
+
+        emit statusUpdated(QString("Возобновление с позиции %1: %2").arg(journal.offset).arg(filePath));
+    }
+
+    while (journal.offset < size && !m_stopRequested) {
+        const qint64 length = qMin(IN_PLACE_STEP_SIZE, size - journal.offset);
+
+        if (!file.seek(journal.offset) || file.read(buffer.data(), length) != length) {
+            return false;
+        }
+        clock.lap(ProcessingMetrics::ReadStage);
+
+        journal.pendingLength = length;
+        journal.pendingHash = hashBytes(buffer.data(), length);
+        if (!saveJournal(journalPath, journal)) {
+            return false;
+        }
+
+        if (checksums) {
+            checksums->input.update(buffer.data(), length);
+        }
+        xorProcessBuffer(buffer.data(), length, journal.offset);
+        if (checksums) {
+            checksums->output.update(buffer.data(), length);
+        }
+        clock.lap(ProcessingMetrics::TransformStage);
+
+        if (!file.seek(journal.offset) || file.write(buffer.data(), length) != length
+            || !syncFileData(file)) {
+            return false;
+        }
+
+        journal.offset += length;
+        journal.pendingLength = 0;
+        if (!saveJournal(journalPath, journal)) {
+            return false;
+        }
+        clock.lap(ProcessingMetrics::WriteStage);
+        m_metrics.addBytes(length);
+    }
+
+    file.close();
+    clock.lap(ProcessingMetrics::CloseStage);
+
+    return journal.offset >= size;
+}
+
+QString FileProcessor::reserveOutputFilePath(const QString &inputFile, const QString &outputFilePath)
+{
+    if (m_settings.overwriteOutput) {
+        return outputFilePath;
+    }
+
+    // A stopped output keeps its temporary file, which holds the name it was given;
+    // the next run takes that name again so the checkpoint can continue the file.
+    JobCheckpoint::FileState state;
+    if (m_checkpoint && m_checkpoint->fileState(inputFile, &state) && state.tempPath.endsWith(PART_SUFFIX)) {
+        const QString resumedPath = state.tempPath.left(state.tempPath.size() - int(qstrlen(PART_SUFFIX)));
+        if (QFileInfo(resumedPath).absolutePath() == QFileInfo(outputFilePath).absolutePath()
+            && QFile::exists(state.tempPath) && !QFile::exists(resumedPath)) {
+            return resumedPath;
+        }
+    }
+    return m_outputNames.reserve(outputFilePath);
+}
+
+void FileProcessor::releaseOutputFilePath(const QString &outputFilePath)
+{
+    if (!m_settings.overwriteOutput) {
+        m_outputNames.release(outputFilePath);
+    }
+}
+
+bool FileProcessor::publishOutputFile(const QString &partFilePath, const QString &outputFilePath) const
+{
+    return m_settings.overwriteOutput ? replaceFile(partFilePath, outputFilePath)
+                                      : publishFile(partFilePath, outputFilePath);
+}
+
+bool FileProcessor::processFile(const QString &inputFilePath, const QString &outputFilePath, BufferPool &pool,
+                                FileChecksums *checksums)
+{
+    const qint64 inputSize = QFileInfo(inputFilePath).size();
+
+    // Copies made inside the kernel never pass through memory, so there is nothing to hash.
+    if (m_settings.key.kind() == XorKey::IdentityKey && !checksums) {
+#ifdef Q_OS_LINUX
+        bool unsupported = false;
+        const bool ok = copyFileUnchanged(inputFilePath, outputFilePath, inputSize, &unsupported);
+        if (!unsupported) {
+            return ok;
+        }
+#endif
+        ++m_plainCopiedCount;
+    }
+
+#ifdef Q_OS_UNIX
+    // Parallel ranges finish out of order, while the hashes are computed front to back.
+    const bool largeFile = m_settings.largeFileThreshold > 0 && inputSize >= m_settings.largeFileThreshold
+        && !checksums;
+
+    // Only the ranged path records progress inside a file, so resumable runs send
+    // large files there regardless of the engine.
+    if (largeFile && m_checkpoint) {
+        return processFileChunked(inputFilePath, outputFilePath, inputSize);
+    }
+#endif
+
+    if (m_settings.ioEngine == FileProcessorSettings::MemoryMappedIo && inputSize > 0) {
+        bool mappingFailed = false;
+        const bool ok = processFileMapped(inputFilePath, outputFilePath, inputSize, checksums, &mappingFailed);
+        if (!mappingFailed) {
+            return ok;
+        }
+        // The fallback starts over from the first byte; windows hashed before the failed
+        // mapping would otherwise be hashed twice.
+        if (checksums) {
+            checksums->input.reset();
+            checksums->output.reset();
+        }
+    }
+
+#ifdef Q_OS_LINUX
+    if (m_settings.cachePolicy == FileProcessorSettings::DirectIo) {
+        bool unsupported = false;
+        const bool ok = processFileDirect(inputFilePath, outputFilePath, pool, checksums, &unsupported);
+        if (!unsupported) {
+            return ok;
+        }
+    }
+#endif
+
+#ifdef Q_OS_UNIX
+    if (largeFile) {
+        return processFileChunked(inputFilePath, outputFilePath, inputSize);
+    }
+#endif
+
+    StageClock clock(m_metrics);
+
+    QFile inputFile(inputFilePath);
+    QFile outputFile(outputFilePath);
+
+    // QFile's own buffering would only add a copy: every transfer below is at least a
+    // whole file or a whole pool buffer.
+    if (!inputFile.open(QIODevice::ReadOnly | QIODevice::Unbuffered)) {
+        return false;
+    }
+
+    if (!outputFile.open(QIODevice::WriteOnly | QIODevice::Unbuffered)) {
+        return false;
+    }
+    clock.lap(ProcessingMetrics::OpenStage);
+
+    qint64 totalSize = inputFile.size();
+    const bool dropCache = m_settings.cachePolicy == FileProcessorSettings::DropCache;
+
+    if (totalSize <= pool.bufferSize()) {
+        char *buffer = pool.acquire();
+        clock.reset();
+        // Asking for exactly the file size lets a small file arrive in a single read call.
+        const qint64 bytesRead = totalSize > 0 ? inputFile.read(buffer, totalSize) : 0;
+        clock.lap(ProcessingMetrics::ReadStage);
+        bool ok = bytesRead >= 0;
+        if (ok && bytesRead > 0) {
+            if (checksums) {
+                checksums->input.update(buffer, bytesRead);
+            }
+            xorProcessBuffer(buffer, bytesRead, 0);
+            if (checksums) {
+                checksums->output.update(buffer, bytesRead);
+            }
+            clock.lap(ProcessingMetrics::TransformStage);
+            ok = outputFile.write(buffer, bytesRead) == bytesRead;
+        }
+        pool.release(buffer);
+
+        if (ok && dropCache && bytesRead > 0) {
+            dropCleanRange(inputFile.handle(), 0, bytesRead);
+            ok = outputFile.flush();
+            dropWrittenRange(outputFile.handle(), 0, bytesRead);
+        }
+        clock.lap(ProcessingMetrics::WriteStage);
+        if (ok) {
+            m_metrics.addBytes(bytesRead);
+        }
+
+        inputFile.close();
+        outputFile.close();
+        clock.lap(ProcessingMetrics::CloseStage);
+        return ok && !m_stopRequested;
+    }
+
+    preallocate(outputFile.handle(), totalSize);
+
+    struct Chunk
+    {
+        char *data;
+        qint64 length;
+        qint64 offset;
+    };
+
+    BlockingQueue<Chunk> transformQueue;
+    BlockingQueue<Chunk> writeQueue;
+    std::atomic<bool> failed(false);
+
+    std::thread transformer([&]() {
+        StageClock transformClock(m_metrics);
+        Chunk chunk;
+        while (transformQueue.pop(&chunk)) {
+            if (!failed) {
+                transformClock.reset();
+                xorProcessBuffer(chunk.data, chunk.length, chunk.offset);
+                if (checksums) {
+                    checksums->output.update(chunk.data, chunk.length);
+                }
+                transformClock.lap(ProcessingMetrics::TransformStage);
+            }
+            writeQueue.push(chunk);
+        }
+        writeQueue.close();
+    });
+
+    std::thread writer([&]() {
+        StageClock writeClock(m_metrics);
+        Chunk chunk;
+        Chunk previous = { nullptr, 0, 0 };
+        while (writeQueue.pop(&chunk)) {
+            writeClock.reset();
+            if (!failed && outputFile.write(chunk.data, chunk.length) != chunk.length) {
+                failed = true;
+            }
+            pool.release(chunk.data);
+            m_metrics.adjustPipelineDepth(-1);
+            if (!failed) {
+                m_metrics.addBytes(chunk.length);
+            }
+
+            // Write-behind: kick off writeback for this chunk, then wait for and drop the previous one.
+            if (dropCache && !failed && outputFile.flush()) {
+                startWriteback(outputFile.handle(), chunk.offset, chunk.length);
+                if (previous.length > 0) {
+                    dropWrittenRange(outputFile.handle(), previous.offset, previous.length);
+                }
+                previous = chunk;
+            }
+            writeClock.lap(ProcessingMetrics::WriteStage);
+        }
+        if (dropCache && previous.length > 0) {
+            dropWrittenRange(outputFile.handle(), previous.offset, previous.length);
+        }
+    });
+
+    qint64 processedSize = 0;
+
+    while (!failed && !m_stopRequested) {
+        char *buffer = pool.acquire();
+        clock.reset();
+        const qint64 bytesRead = inputFile.read(buffer, pool.bufferSize());
+        clock.lap(ProcessingMetrics::ReadStage);
+        if (bytesRead <= 0) {
+            pool.release(buffer);
+            if (bytesRead < 0) {
+                failed = true;
+            }
+            break;
+        }
+
+        if (dropCache) {
+            dropCleanRange(inputFile.handle(), processedSize, bytesRead);
+        }
+        // The reader hashes the input while the transformer hashes the previous chunk's output.
+        if (checksums) {
+            checksums->input.update(buffer, bytesRead);
+        }
+
+        m_metrics.adjustPipelineDepth(1);
+        transformQueue.push({ buffer, bytesRead, processedSize });
+        processedSize += bytesRead;
+    }
+
+    transformQueue.close();
+    transformer.join();
+    writer.join();
+
+    clock.reset();
+    inputFile.close();
+    outputFile.close();
+    clock.lap(ProcessingMetrics::CloseStage);
+
+    return !failed && !m_stopRequested;
+}
+
+bool FileProcessor::processFileMapped(const QString &inputFilePath, const QString &outputFilePath,
+                                      qint64 size, FileChecksums *checksums, bool *mappingFailed)
+{
+    StageClock clock(m_metrics);
+
+    QFile inputFile(inputFilePath);
+    QFile outputFile(outputFilePath);
+
+    if (!inputFile.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    if (!outputFile.open(QIODevice::ReadWrite | QIODevice::Truncate)) {
+        return false;
+    }
+
+    preallocate(outputFile.handle(), size);
+    if (!outputFile.resize(size)) {
+        *mappingFailed = true;
+        return false;
+    }
+    clock.lap(ProcessingMetrics::OpenStage);
+
+    for (qint64 offset = 0; offset < size && !m_stopRequested; offset += MAP_WINDOW_SIZE) {
+        const qint64 length = qMin(MAP_WINDOW_SIZE, size - offset);
+
+        uchar *source = inputFile.map(offset, length);
+        uchar *target = source ? outputFile.map(offset, length) : nullptr;
+        if (!target) {
+            if (source) {
+                inputFile.unmap(source);
+            }
+            *mappingFailed = true;
+            return false;
+        }
+
+#ifdef Q_OS_UNIX
+        ::posix_madvise(source, length, POSIX_MADV_SEQUENTIAL);
+        ::posix_madvise(target, length, POSIX_MADV_SEQUENTIAL);
+#endif
+
+        if (checksums) {
+            checksums->input.update(reinterpret_cast<const char *>(source), length);
+        }
+        XorKernel::apply(reinterpret_cast<const char *>(source), reinterpret_cast<char *>(target),
+                         length, m_settings.key, offset);
+        if (checksums) {
+            checksums->output.update(reinterpret_cast<const char *>(target), length);
+        }
+
+        inputFile.unmap(source);
+        outputFile.unmap(target);
+
+        // Page faults make reads and writes part of the transform here.
+        clock.lap(ProcessingMetrics::TransformStage);
+        m_metrics.addBytes(length);
+    }
+
+    inputFile.close();
+    outputFile.close();
+    clock.lap(ProcessingMetrics::CloseStage);
+
+    return !m_stopRequested;
+}
+
+#ifdef Q_OS_LINUX
+bool FileProcessor::processFileDirect(const QString &inputFilePath, const QString &outputFilePath,
+                                      BufferPool &pool, FileChecksums *checksums, bool *unsupported)
+{
+    StageClock clock(m_metrics);
+
+    int inputFd = ::open(QFile::encodeName(inputFilePath).constData(), O_RDONLY | O_DIRECT | O_CLOEXEC);
+    if (inputFd < 0) {
+        *unsupported = errno == EINVAL;
+        return false;
+    }
+
+    int outputFd = ::open(QFile::encodeName(outputFilePath).constData(),
+                          O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT | O_CLOEXEC, 0666);
+    if (outputFd < 0) {
+        *unsupported = errno == EINVAL;
+        ::close(inputFd);
+        return false;
+    }
+
+    struct stat inputStat;
+    if (::fstat(inputFd, &inputStat) == 0) {
+        preallocate(outputFd, inputStat.st_size);
+    }
+
+    // Pool buffers are ALIGNMENT-aligned and a whole number of ALIGNMENT blocks long,
+    // so every transfer below starts on an aligned offset.
+    clock.lap(ProcessingMetrics::OpenStage);
+
+    char *buffer = pool.acquire();
+    const qint64 chunkSize = pool.bufferSize();
+    qint64 offset = 0;
+    bool ok = true;
+
+    while (ok && !m_stopRequested) {
+        ssize_t bytesRead = ::pread(inputFd, buffer, chunkSize, offset);
+        if (bytesRead < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytesRead <= 0) {
+            ok = bytesRead == 0;
+            break;
+        }
+        clock.lap(ProcessingMetrics::ReadStage);
+
+        if (checksums) {
+            checksums->input.update(buffer, bytesRead);
+        }
+        xorProcessBuffer(buffer, bytesRead, offset);
+        if (checksums) {
+            checksums->output.update(buffer, bytesRead);
+        }
+        clock.lap(ProcessingMetrics::TransformStage);
+
+        const qint64 alignedLength = bytesRead / BufferPool::ALIGNMENT * BufferPool::ALIGNMENT;
+        if (alignedLength > 0 && !pwriteFully(outputFd, buffer, alignedLength, offset)) {
+            ok = false;
+            break;
+        }
+
+        if (alignedLength < bytesRead) {
+            // O_DIRECT cannot write the unaligned final block, so it goes through the page cache.
+            const int flags = ::fcntl(outputFd, F_GETFL);
+            const qint64 tailLength = bytesRead - alignedLength;
+            ok = flags >= 0 && ::fcntl(outputFd, F_SETFL, flags & ~O_DIRECT) == 0
+                && pwriteFully(outputFd, buffer + alignedLength, tailLength, offset + alignedLength);
+            if (ok) {
+                dropWrittenRange(outputFd, offset + alignedLength, tailLength);
+            }
+        }
+
+        clock.lap(ProcessingMetrics::WriteStage);
+        m_metrics.addBytes(bytesRead);
+
+        offset += bytesRead;
+        if (bytesRead < chunkSize) {
+            break;
+        }
+    }
+
+    pool.release(buffer);
+    clock.reset();
+    ::close(inputFd);
+    if (::close(outputFd) != 0) {
+        ok = false;
+    }
+    clock.lap(ProcessingMetrics::CloseStage);
+
+    return ok && !m_stopRequested;
+}
+#endif
+
+#ifdef Q_OS_LINUX
+bool FileProcessor::copyFileUnchanged(const QString &inputFilePath, const QString &outputFilePath, qint64 size,
+                                      bool *unsupported)
+{
+    StageClock clock(m_metrics);
+
+    const int inputFd = ::open(QFile::encodeName(inputFilePath).constData(), O_RDONLY | O_CLOEXEC);
+    if (inputFd < 0) {
+        return false;
+    }
+
+    const int outputFd = ::open(QFile::encodeName(outputFilePath).constData(),
+                                O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (outputFd < 0) {
+        ::close(inputFd);
+        return false;
+    }
+    clock.lap(ProcessingMetrics::OpenStage);
+
+    bool ok = true;
+
+    // A reflink shares the input's extents, so no data is read or written at all.
+    if (::ioctl(outputFd, FICLONE, inputFd) == 0) {
+        ++m_clonedCount;
+        m_metrics.addBytes(size);
+        clock.lap(ProcessingMetrics::WriteStage);
+    } else {
+        // copy_file_range keeps the data in the kernel and may still offload or share it.
+        loff_t inputOffset = 0;
+        loff_t outputOffset = 0;
+        while (inputOffset < size && !m_stopRequested) {
+            const ssize_t copied = ::copy_file_range(inputFd, &inputOffset, outputFd, &outputOffset,
+                                                     size_t(qMin<qint64>(COPY_RANGE_STEP, size - inputOffset)), 0);
+            if (copied < 0 && errno == EINTR) {
+                continue;
+            }
+            if (copied <= 0) {
+                // Older kernels and some filesystem pairs refuse before copying anything;
+                // those files go through the regular path.
+                *unsupported = copied < 0 && inputOffset == 0
+                    && (errno == EXDEV || errno == EINVAL || errno == ENOSYS || errno == EOPNOTSUPP);
+                ok = false;
+                break;
+            }
+            clock.lap(ProcessingMetrics::WriteStage);
+            m_metrics.addBytes(copied);
+        }
+        if (ok) {
+            ++m_rangeCopiedCount;
+        }
+    }
+
+    ::close(inputFd);
+    if (::close(outputFd) != 0) {
+        ok = false;
+    }
+    clock.lap(ProcessingMetrics::CloseStage);
+
+    return ok && !m_stopRequested;
+}
+#endif
+
+#ifdef Q_OS_UNIX
+bool FileProcessor::processFileChunked(const QString &inputFilePath, const QString &outputFilePath, qint64 size)
+{
+    StageClock clock(m_metrics);
+
+    // A checkpointed file continues only if the input is unchanged and the partial
+    // output it refers to is still there.
+    const qint64 modifiedMs = QFileInfo(inputFilePath).lastModified().toMSecsSinceEpoch();
+    JobCheckpoint::FileState state;
+    const bool resuming = m_checkpoint && m_checkpoint->fileState(inputFilePath, &state)
+        && state.inputSize == size && state.inputModifiedMs == modifiedMs && state.tempPath == outputFilePath
+        && !state.ranges.isEmpty() && QFile::exists(outputFilePath);
+
+    int inputFd = ::open(QFile::encodeName(inputFilePath).constData(), O_RDONLY | O_CLOEXEC);
+    if (inputFd < 0) {
+        return false;
+    }
+
+    int outputFd = ::open(QFile::encodeName(outputFilePath).constData(),
+                          O_WRONLY | O_CREAT | (resuming ? 0 : O_TRUNC) | O_CLOEXEC, 0666);
+    if (outputFd < 0) {
+        ::close(inputFd);
+        return false;
+    }
+
+    preallocate(outputFd, size);
+    if (::ftruncate(outputFd, size) != 0) {
+        ::close(inputFd);
+        ::close(outputFd);
+        return false;
+    }
+    clock.lap(ProcessingMetrics::OpenStage);
+
+    // Ranged files are large by definition, so they keep the device's full size even
+    // when the pool buffers were shrunk for a set of small files.
+    const qint64 chunkSize = m_chunkSize;
+
+    if (resuming) {
+        qint64 doneSize = 0;
+        for (const JobCheckpoint::Range &range : state.ranges) {
+            doneSize += range.done;
+        }
+        emit statusUpdated(QString("Возобновление с позиции %1 из %2: %3").arg(doneSize).arg(size).arg(inputFilePath));
+    } else {
+        const qint64 blockCount = (size + chunkSize - 1) / chunkSize;
+        int threadCount = m_settings.largeFileThreads > 0 ? m_settings.largeFileThreads : QThread::idealThreadCount();
+        threadCount = static_cast<int>(qBound<qint64>(1, threadCount, blockCount));
+
+        // Ranges are whole multiples of the chunk size, so each starts on a key boundary
+        // and the kernel derives the phase from the absolute offset anyway.
+        const qint64 rangeSize = ((blockCount + threadCount - 1) / threadCount) * chunkSize;
+
+        state = JobCheckpoint::FileState();
+        state.inputSize = size;
+        state.inputModifiedMs = modifiedMs;
+        state.tempPath = outputFilePath;
+        for (qint64 begin = 0; begin < size; begin += rangeSize) {
+            JobCheckpoint::Range range;
+            range.begin = begin;
+            range.end = qMin(begin + rangeSize, size);
+            state.ranges.append(range);
+        }
+
+        if (m_checkpoint) {
+            m_checkpoint->setFileState(inputFilePath, state);
+        }
+    }
+
+    const std::vector<JobCheckpoint::Range> ranges(state.ranges.cbegin(), state.ranges.cend());
+    std::vector<std::atomic<qint64>> rangeDone(ranges.size());
+    for (size_t i = 0; i < ranges.size(); ++i) {
+        rangeDone[i] = ranges[i].done;
+    }
+
+    // Offsets are sampled before the sync, so every byte the checkpoint claims is on disk.
+    auto saveProgress = [&]() {
+        JobCheckpoint::FileState progress = state;
+        for (int i = 0; i < progress.ranges.size(); ++i) {
+            progress.ranges[i].done = rangeDone[i].load(std::memory_order_acquire);
+        }
+        if (syncDescriptor(outputFd, true)) {
+            m_checkpoint->setFileState(inputFilePath, progress);
+        }
+    };
+
+    const bool dropCache = m_settings.cachePolicy == FileProcessorSettings::DropCache;
+    std::atomic<bool> failed(false);
+    QMutex runningMutex;
+    QWaitCondition runningWake;
+    int runningCount = int(ranges.size());
+
+    auto processRange = [&](size_t index) {
+        StageClock rangeClock(m_metrics);
+        std::vector<char> buffer(chunkSize);
+        const qint64 begin = ranges[index].begin;
+        const qint64 end = ranges[index].end;
+
+        for (qint64 offset = begin + ranges[index].done; offset < end && !failed && !m_stopRequested;
+             offset += chunkSize) {
+            const qint64 length = qMin(chunkSize, end - offset);
+            if (preadFully(inputFd, buffer.data(), length, offset) != length) {
+                failed = true;
+                break;
+            }
+            rangeClock.lap(ProcessingMetrics::ReadStage);
+
+            xorProcessBuffer(buffer.data(), length, offset);
+            rangeClock.lap(ProcessingMetrics::TransformStage);
+
+            if (!pwriteFully(outputFd, buffer.data(), length, offset)) {
+                failed = true;
+                break;
+            }
+
+            if (dropCache) {
+                dropCleanRange(inputFd, offset, length);
+                dropWrittenRange(outputFd, offset, length);
+            }
+            rangeClock.lap(ProcessingMetrics::WriteStage);
+            m_metrics.addBytes(length);
+            rangeDone[index].store(offset + length - begin, std::memory_order_release);
+        }
+
+        QMutexLocker locker(&runningMutex);
+        --runningCount;
+        runningWake.wakeAll();
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(ranges.size());
+    for (size_t i = 0; i < ranges.size(); ++i) {
+        threads.emplace_back(processRange, i);
+    }
+
+    if (m_checkpoint) {
+        QMutexLocker locker(&runningMutex);
+        while (runningCount > 0) {
+            runningWake.wait(&runningMutex, CHECKPOINT_INTERVAL_MS);
+            if (runningCount > 0) {
+                locker.unlock();
+                saveProgress();
+                locker.relock();
+            }
+        }
+    }
+
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+
+    if (m_checkpoint && m_stopRequested && !failed) {
+        saveProgress();
+    }
+
+    clock.reset();
+    ::close(inputFd);
+    const bool closed = ::close(outputFd) == 0;
+    clock.lap(ProcessingMetrics::CloseStage);
+
+    return closed && !failed && !m_stopRequested;
+}
+#endif
+
+QStringList FileProcessor::fileMaskFilters(const QString &fileMask)
+{
+    QStringList masks = fileMask.split(';', Qt::SkipEmptyParts);
+    for (QString &mask : masks) {
+        mask = mask.trimmed();
+    }
+
+    if (masks.isEmpty()) {
+        masks << "*";
+    }
+
+    return masks;
+}
+
+void FileProcessor::enumerateInputFiles(const std::function<bool(const QString &)> &callback)
+{
+    const QString outputRoot = QDir(m_settings.outputPath).absolutePath() + '/';
+    const QString manifestPath = ChecksumManifest::filePath(m_settings.outputPath);
+
+    QDirIterator it(m_settings.inputPath, fileMaskFilters(m_settings.fileMask), QDir::Files | QDir::Readable,
+                    m_settings.recursive ? QDirIterator::Subdirectories : QDirIterator::NoIteratorFlags);
+
+    while (it.hasNext()) {
+        const QString filePath = QFileInfo(it.next()).absoluteFilePath();
+
+        if (filePath.endsWith(JOURNAL_SUFFIX) || filePath.endsWith(PART_SUFFIX) || filePath == manifestPath
+            || PackWriter::isPackFile(filePath)) {
+            continue;
+        }
+        if (m_settings.recursive && filePath.startsWith(outputRoot)) {
+            continue;
+        }
+        if (!callback(filePath)) {
+            break;
+        }
+    }
+}
+
+void FileProcessor::xorProcessBuffer(char *buffer, qint64 size, qint64 offset)
+{
+    XorKernel::apply(buffer, buffer, size, m_settings.key, offset);
 }
@@ -6,15 +6,84 @@
 #include <QStringList>
 #include <QDir>
 #include <QFileInfo>
+#include <QMutex>
+#include <QSet>
+#include <QHash>
+#include <QVector>
+#include <QScopedPointer>
+#include <atomic>
+#include <functional>
+#include <vector>
+#include "checksum.h"
+#include "checksummanifest.h"
+#include "jobcheckpoint.h"
+#include "outputnameindex.h"
+#include "packarchive.h"
+#include "processedindex.h"
+#include "processingmetrics.h"
+#include "xorkey.h"
+
+class BufferPool;
+class UringEngine;
 
 struct FileProcessorSettings
 {
+    enum IoEngine {
+        BufferedIo,
+        MemoryMappedIo,
+        UringIo
+    };
+
+    enum CachePolicy {
+        PageCache,
+        DropCache,
+        DirectIo
+    };
+
+    enum Durability {
+        NoSync,
+        SyncEachFile,
+        GroupCommit
+    };
+
+    enum OutputFormat {
+        SeparateFiles,
+        PackedSegments
+    };
+
+    enum MetricsFormat {
+        JsonMetrics,
+        PrometheusMetrics
+    };
+
     QString inputPath;
     QString outputPath;
     QString fileMask;
+    bool recursive = false;
     bool deleteInputFiles = false;
     bool overwriteOutput = true;
-    quint64 xorValue = 0;
+    bool transformInPlace = false;
+    XorKey key;
+    int workerCount = 0;
+    qint64 largeFileThreshold = 256 * 1024 * 1024;
+    int largeFileThreads = 0;
+    IoEngine ioEngine = BufferedIo;
+    CachePolicy cachePolicy = PageCache;
+    Durability durability = NoSync;
+    qint64 bufferSize = 0;
+    int queueDepth = 4;
+    bool skipUnchanged = false;
+    bool indexContentHash = false;
+    bool resumable = false;
+    Checksum::Algorithm checksumAlgorithm = Checksum::NoChecksum;
+    bool checksumInput = false;
+    bool verifyManifest = false;
+    OutputFormat outputFormat = SeparateFiles;
+    qint64 packSegmentSize = PackWriter::DEFAULT_SEGMENT_SIZE;
+    QString indexPath;
+    QString metricsPath;
+    MetricsFormat metricsFormat = JsonMetrics;
+    int metricsIntervalMs = 1000;
 };
 
 class FileProcessor : public QThread
@@ -25,26 +94,138 @@ public:
     explicit FileProcessor(QObject *parent = nullptr);
 
     void setSettings(const FileProcessorSettings &settings);
+    void setInputFiles(const QStringList &files);
     void stop();
 
+    static QStringList fileMaskFilters(const QString &fileMask);
+
+    // Driving a run from outside, as JobScheduler does: the caller enumerates and
+    // schedules the files itself instead of starting the thread.
+    bool beginExternalRun();
+    bool acceptInputFile(const QString &inputFile);
+    bool processExternalFile(const QString &inputFile, BufferPool &pool);
+    void endExternalRun();
+    void enumerateInputFiles(const std::function<bool(const QString &)> &callback);
+    // Emits metricsUpdated and rewrites the metrics file; run() does this on its own.
+    void publishMetrics();
+
+    FileProcessorSettings settings() const { return m_settings; }
+    qint64 bufferSize() const { return m_bufferSize; }
+    bool isStopRequested() const { return m_stopRequested; }
+
 signals:
     void progressUpdated(int progress);
+    void currentFileChanged(const QString &fileName);
     void statusUpdated(const QString &status);
     void errorOccurred(const QString &error);
+    void runCompleted(int processedCount, int skippedCount, int totalCount);
+    void fileProcessed(const QString &inputFile, qint64 elapsedNs, bool ok);
+    void metricsUpdated(const ProcessingMetrics::Snapshot &snapshot);
 
 protected:
     void run() override;
 
 private:
-    bool processFile(const QString &inputFilePath, const QString &outputFilePath);
-    QString generateUniqueFileName(const QString &basePath);
-    QStringList findInputFiles();
-    void xorProcessBuffer(char *buffer, qint64 size);
+    // Hashes fed from the processing loops: the input before the XOR, the output after it.
+    struct FileChecksums
+    {
+        FileChecksums(Checksum::Algorithm algorithm, bool withInput)
+            : input(withInput ? algorithm : Checksum::NoChecksum)
+            , output(algorithm)
+        {
+        }
+
+        ChecksumManifest::Entry entry(qint64 size) const
+        {
+            ChecksumManifest::Entry result;
+            result.inputChecksum = input.toHex();
+            result.outputChecksum = output.toHex();
+            result.size = size;
+            return result;
+        }
+
+        Checksum input;
+        Checksum output;
+    };
+
+    // An input waiting for a group commit; an in-place output was the input itself,
+    // so there is nothing left to delete.
+    struct PendingInput
+    {
+        QString inputFile;
+        bool deleteInput;
+    };
+
+    bool prepareRun();
+    void finishRun();
+    void runVerification();
+    bool processInputFile(const QString &inputFile, const QDir &outputDir, BufferPool &pool);
+    bool processInputFilePacked(const QString &inputFile, BufferPool &pool);
+    int processInputBatch(const QStringList &inputFiles, const QDir &outputDir, UringEngine &engine);
+    bool shouldTransformInPlace(const QFileInfo &fileInfo, const QDir &outputDir) const;
+    void completeInputFile(const QString &inputFile, const QString &outputFilePath, bool inputMoved = false);
+    void commitPendingInputFiles();
+    void finishInputFile(const QString &inputFile, bool deleteInput);
+    bool processInputFileInPlace(const QString &inputFile, const QString &outputFilePath);
+    bool transformInPlace(const QString &filePath, FileChecksums *checksums);
+    bool processFile(const QString &inputFilePath, const QString &outputFilePath, BufferPool &pool,
+                     FileChecksums *checksums);
+    bool processFileMapped(const QString &inputFilePath, const QString &outputFilePath, qint64 size,
+                           FileChecksums *checksums, bool *mappingFailed);
+    bool processFileDirect(const QString &inputFilePath, const QString &outputFilePath, BufferPool &pool,
+                           FileChecksums *checksums, bool *unsupported);
+    bool processFileChunked(const QString &inputFilePath, const QString &outputFilePath, qint64 size);
+    bool copyFileUnchanged(const QString &inputFilePath, const QString &outputFilePath, qint64 size, bool *unsupported);
+    QString reserveOutputFilePath(const QString &inputFile, const QString &outputFilePath);
+    void releaseOutputFilePath(const QString &outputFilePath);
+    bool publishOutputFile(const QString &partFilePath, const QString &outputFilePath) const;
+    QString relativeOutputPath(const QString &inputFile) const;
+    QString outputPathFor(const QString &inputFile, const QDir &outputDir) const;
+    void setCurrentFile(const QString &fileName);
+#ifdef Q_OS_UNIX
+    int processSmallFileBatch(const QString &firstFile, const std::function<bool(QString *)> &nextFile,
+                              const QDir &outputDir, BufferPool &pool, std::vector<char> &arena, int *handledCount);
+#endif
+    void reportFile(const QString &inputFile, qint64 elapsedNs, bool ok);
+    void xorProcessBuffer(char *buffer, qint64 size, qint64 offset);
 
     FileProcessorSettings m_settings;
-    bool m_stopRequested;
+    QStringList m_inputFiles;
+    std::atomic<bool> m_stopRequested;
+    QDir m_outputDir;
+
+    QScopedPointer<ProcessedIndex> m_index;
+    QScopedPointer<JobCheckpoint> m_checkpoint;
+    QScopedPointer<ChecksumManifest> m_manifest;
+    QScopedPointer<PackWriter> m_packWriter;
+    QMutex m_indexStampsMutex;
+    QHash<QString, ProcessedIndex::Stamp> m_indexStamps;
+    int m_lastDiscoveredCount;
+    qint64 m_bufferSize;
+    qint64 m_chunkSize;
+    ProcessingMetrics m_metrics;
+    QMutex m_pendingCommitMutex;
+    QVector<PendingInput> m_pendingCommit;
+    std::atomic<int> m_clonedCount;
+    std::atomic<int> m_rangeCopiedCount;
+    std::atomic<int> m_plainCopiedCount;
+    QMutex m_currentFileMutex;
+    QString m_currentFile;
+
+    OutputNameIndex m_outputNames;
 
-    static const qint64 BUFFER_SIZE = 1024 * 1024;
+    static constexpr qint64 BUFFER_SIZE = 1024 * 1024;
+    static constexpr qint64 MAP_WINDOW_SIZE = 64 * 1024 * 1024;
+    static constexpr qint64 IN_PLACE_STEP_SIZE = 8 * BUFFER_SIZE;
+    static constexpr int INPUT_QUEUE_CAPACITY = 4096;
+    static constexpr int REPORT_INTERVAL_MS = 50;
+    static constexpr qint64 SMALL_FILE_LIMIT = 64 * 1024;
+    static constexpr qint64 SMALL_FILE_ARENA_SIZE = 4 * 1024 * 1024;
+    static constexpr int SMALL_FILE_BATCH = 256;
+    static constexpr int GROUP_COMMIT_SIZE = 512;
+    static constexpr int BUFFER_SIZE_SAMPLE = 256;
+    static constexpr int CHECKPOINT_INTERVAL_MS = 5000;
+    static constexpr qint64 COPY_RANGE_STEP = 64 * 1024 * 1024;
 };
 
 #endif // FILEPROCESSOR_H
@@ -0,0 +1,252 @@
+#include "jobcheckpoint.h"
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+namespace {
+
+const quint32 CHECKPOINT_MAGIC = 0x58434b50;
+const quint32 CHECKPOINT_VERSION = 1;
+const char COMPLETED_LOG_SUFFIX[] = ".done";
+
+} // namespace
+
+JobCheckpoint::JobCheckpoint(const QString &filePath, quint64 xorValue)
+    : m_filePath(filePath)
+    , m_xorValue(xorValue)
+    , m_completedLog(filePath + COMPLETED_LOG_SUFFIX)
+{
+}
+
+JobCheckpoint::~JobCheckpoint()
+{
+    flush();
+}
+
+QString JobCheckpoint::defaultFilePath(const QString &inputPath, const QString &outputPath)
+{
+    const QByteArray id = QCryptographicHash::hash(
+        (QDir(inputPath).absolutePath() + '\n' + QDir(outputPath).absolutePath()).toUtf8(),
+        QCryptographicHash::Sha1).toHex().left(16);
+
+    return QDir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation))
+        .absoluteFilePath(QString("job-%1.dat").arg(QString::fromLatin1(id)));
+}
+
+bool JobCheckpoint::load()
+{
+    QMutexLocker locker(&m_mutex);
+    m_completed.clear();
+    m_inProgress.clear();
+    m_completedLog.close();
+
+    bool ok = true;
+
+    QFile file(m_filePath);
+    if (file.open(QIODevice::ReadOnly)) {
+        QDataStream stream(&file);
+        quint32 magic = 0;
+        quint32 version = 0;
+        quint64 xorValue = 0;
+        qint32 count = 0;
+        stream >> magic >> version >> xorValue >> count;
+
+        if (stream.status() != QDataStream::Ok || magic != CHECKPOINT_MAGIC || version != CHECKPOINT_VERSION) {
+            ok = false;
+        } else if (xorValue == m_xorValue) {
+            for (qint32 i = 0; i < count && ok; ++i) {
+                QString inputFile;
+                FileState state;
+                qint32 rangeCount = 0;
+                stream >> inputFile >> state.inputSize >> state.inputModifiedMs >> state.tempPath >> rangeCount;
+                for (qint32 r = 0; r < rangeCount && stream.status() == QDataStream::Ok; ++r) {
+                    Range range;
+                    stream >> range.begin >> range.end >> range.done;
+                    state.ranges.append(range);
+                }
+                ok = stream.status() == QDataStream::Ok;
+                if (ok) {
+                    m_inProgress.insert(inputFile, state);
+                }
+            }
+        } else {
+            // Progress made under another key cannot be continued.
+            QFile::remove(m_completedLog.fileName());
+        }
+    } else if (file.exists()) {
+        ok = false;
+    }
+
+    if (!ok) {
+        m_inProgress.clear();
+        QFile::remove(m_completedLog.fileName());
+    }
+
+    // Lines are "<size>\t<modified ms>\t<path>"; anything else is ignored, which only
+    // costs processing that file again.
+    if (m_completedLog.open(QIODevice::ReadOnly)) {
+        while (!m_completedLog.atEnd()) {
+            QString line = QString::fromUtf8(m_completedLog.readLine());
+            if (line.endsWith('\n')) {
+                line.chop(1);
+            }
+            const int sizeEnd = line.indexOf('\t');
+            const int modifiedEnd = sizeEnd < 0 ? -1 : line.indexOf('\t', sizeEnd + 1);
+            if (modifiedEnd < 0) {
+                continue;
+            }
+
+            bool sizeOk = false;
+            bool modifiedOk = false;
+            InputStamp stamp;
+            stamp.size = line.left(sizeEnd).toLongLong(&sizeOk);
+            stamp.modifiedMs = line.mid(sizeEnd + 1, modifiedEnd - sizeEnd - 1).toLongLong(&modifiedOk);
+            const QString inputFile = line.mid(modifiedEnd + 1);
+            if (sizeOk && modifiedOk && !inputFile.isEmpty()) {
+                m_completed.insert(inputFile, stamp);
+            }
+        }
+        m_completedLog.close();
+    }
+
+    return ok;
+}
+
+bool JobCheckpoint::save()
+{
+    QMutexLocker locker(&m_mutex);
+
+    QDir().mkpath(QFileInfo(m_filePath).absolutePath());
+
+    QSaveFile file(m_filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream << CHECKPOINT_MAGIC << CHECKPOINT_VERSION << m_xorValue << qint32(m_inProgress.size());
+
+    for (auto it = m_inProgress.constBegin(); it != m_inProgress.constEnd(); ++it) {
+        const FileState &state = it.value();
+        stream << it.key() << state.inputSize << state.inputModifiedMs << state.tempPath
+               << qint32(state.ranges.size());
+        for (const Range &range : state.ranges) {
+            stream << range.begin << range.end << range.done;
+        }
+    }
+
+    if (m_completedLog.isOpen()) {
+        m_completedLog.flush();
+    }
+
+    return stream.status() == QDataStream::Ok && file.commit();
+}
+
+void JobCheckpoint::remove()
+{
+    QMutexLocker locker(&m_mutex);
+    m_completed.clear();
+    m_inProgress.clear();
+    m_completedLog.close();
+    QFile::remove(m_completedLog.fileName());
+    QFile::remove(m_filePath);
+}
+
+void JobCheckpoint::flush()
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_completedLog.isOpen()) {
+        m_completedLog.flush();
+    }
+}
+
+bool JobCheckpoint::isEmpty() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_completed.isEmpty() && m_inProgress.isEmpty();
+}
+
+JobCheckpoint::InputStamp JobCheckpoint::stampOf(const QString &inputFile)
+{
+    InputStamp stamp;
+    const QFileInfo fileInfo(inputFile);
+    if (fileInfo.exists()) {
+        stamp.size = fileInfo.size();
+        stamp.modifiedMs = fileInfo.lastModified().toMSecsSinceEpoch();
+    }
+    return stamp;
+}
+
+bool JobCheckpoint::isCompleted(const QString &inputFile) const
+{
+    InputStamp recorded;
+    {
+        QMutexLocker locker(&m_mutex);
+        auto it = m_completed.constFind(inputFile);
+        if (it == m_completed.constEnd()) {
+            return false;
+        }
+        recorded = it.value();
+    }
+
+    const InputStamp current = stampOf(inputFile);
+    return current.size >= 0 && current.size == recorded.size && current.modifiedMs == recorded.modifiedMs;
+}
+
+// An input that is gone by now, deleted or moved by an in-place pass, is recorded
+// with no size, so a new file arriving under its name is processed again.
+void JobCheckpoint::markCompleted(const QString &inputFile)
+{
+    const InputStamp stamp = stampOf(inputFile);
+
+    QMutexLocker locker(&m_mutex);
+
+    if (!m_completedLog.isOpen()) {
+        QDir().mkpath(QFileInfo(m_filePath).absolutePath());
+        if (!m_completedLog.open(QIODevice::WriteOnly | QIODevice::Append)) {
+            return;
+        }
+    }
+
+    m_completed.insert(inputFile, stamp);
+    m_completedLog.write(QString("%1\t%2\t%3\n").arg(stamp.size).arg(stamp.modifiedMs).arg(inputFile).toUtf8());
+}
+
+bool JobCheckpoint::fileState(const QString &inputFile, FileState *state) const
+{
+    QMutexLocker locker(&m_mutex);
+
+    auto it = m_inProgress.constFind(inputFile);
+    if (it == m_inProgress.constEnd()) {
+        return false;
+    }
+
+    *state = it.value();
+    return true;
+}
+
+bool JobCheckpoint::setFileState(const QString &inputFile, const FileState &state)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_inProgress.insert(inputFile, state);
+    }
+    return save();
+}
+
+void JobCheckpoint::clearFileState(const QString &inputFile)
+{
+    bool removed = false;
+    {
+        QMutexLocker locker(&m_mutex);
+        removed = m_inProgress.remove(inputFile) > 0;
+    }
+    if (removed) {
+        save();
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef JOBCHECKPOINT_H
+#define JOBCHECKPOINT_H
+
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+
+// Progress of an interrupted run: the inputs already finished and, for large files in
+// flight, how much of each output range is known to be on disk. Finished inputs are
+// appended to a side log, with their size and modification time, so recording one
+// costs a buffered write, not a rewrite.
+class JobCheckpoint
+{
+public:
+    struct Range
+    {
+        qint64 begin = 0;
+        qint64 end = 0;
+        qint64 done = 0;
+    };
+
+    struct FileState
+    {
+        qint64 inputSize = -1;
+        qint64 inputModifiedMs = 0;
+        QString tempPath;
+        QVector<Range> ranges;
+    };
+
+    JobCheckpoint(const QString &filePath, quint64 xorValue);
+    ~JobCheckpoint();
+
+    static QString defaultFilePath(const QString &inputPath, const QString &outputPath);
+
+    bool load();
+    bool save();
+    void remove();
+    void flush();
+    bool isEmpty() const;
+
+    // True when the input was finished and has not changed since.
+    bool isCompleted(const QString &inputFile) const;
+    void markCompleted(const QString &inputFile);
+
+    bool fileState(const QString &inputFile, FileState *state) const;
+    bool setFileState(const QString &inputFile, const FileState &state);
+    void clearFileState(const QString &inputFile);
+
+private:
+    struct InputStamp
+    {
+        qint64 size = -1;
+        qint64 modifiedMs = 0;
+    };
+
+    static InputStamp stampOf(const QString &inputFile);
+
+    QString m_filePath;
+    quint64 m_xorValue;
+
+    mutable QMutex m_mutex;
+    QHash<QString, InputStamp> m_completed;
+    QHash<QString, FileState> m_inProgress;
+    QFile m_completedLog;
+};
+
+#endif // JOBCHECKPOINT_H
@@ -0,0 +1,463 @@
+#include "jobscheduler.h"
+#include "bufferpool.h"
+#include "buffertuner.h"
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QScopedPointer>
+#include <QStorageInfo>
+#include <QThreadPool>
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+QString deviceKey(const QString &path)
+{
+    const QStorageInfo storage(path);
+    return QString::fromLocal8Bit(storage.device()) + '\n' + storage.rootPath();
+}
+
+bool pathsOverlap(const QString &path, const QString &other)
+{
+    return path == other || path.startsWith(other + '/') || other.startsWith(path + '/');
+}
+
+} // namespace
+
+struct JobScheduler::Job
+{
+    JobProfile profile;
+    QScopedPointer<FileProcessor> processor;
+    // Files found but not yet taken, a heap whose front is the next one in the file order.
+    std::vector<Task> pending;
+    QStringList devices;
+    int discoveredCount = 0;
+    int running = 0;
+    int processedCount = 0;
+    int skippedCount = 0;
+    quint64 lastServed = 0;
+    bool enumerating = true;
+    // Set under m_mutex by whoever ends the job; the periodic metrics are published
+    // under metricsMutex, which ending the job holds as well.
+    std::atomic<bool> finished{ false };
+    QMutex metricsMutex;
+    qint64 lastMetricsMs = 0;
+};
+
+JobScheduler::JobScheduler(QObject *parent)
+    : QThread(parent)
+    , m_workerCount(0)
+    , m_fileOrder(LargestFirst)
+    , m_deviceConcurrency(0)
+    , m_stopRequested(false)
+    , m_serial(0)
+    , m_enumerationDone(false)
+    , m_finishedCount(0)
+    , m_totalCount(0)
+{
+}
+
+JobScheduler::~JobScheduler()
+{
+    stop();
+    wait();
+}
+
+void JobScheduler::addJob(const JobProfile &job)
+{
+    QMutexLocker locker(&m_profilesMutex);
+    m_profiles.append(job);
+}
+
+void JobScheduler::removeJob(int index)
+{
+    QMutexLocker locker(&m_profilesMutex);
+    if (index >= 0 && index < m_profiles.size()) {
+        m_profiles.removeAt(index);
+    }
+}
+
+QList<JobProfile> JobScheduler::jobs() const
+{
+    QMutexLocker locker(&m_profilesMutex);
+    return m_profiles;
+}
+
+void JobScheduler::setWorkerCount(int count)
+{
+    m_workerCount = count;
+}
+
+void JobScheduler::setFileOrder(FileOrder order)
+{
+    m_fileOrder = order;
+}
+
+void JobScheduler::setDeviceConcurrency(int limit)
+{
+    m_deviceConcurrency = limit;
+}
+
+void JobScheduler::stop()
+{
+    m_stopRequested = true;
+
+    QMutexLocker locker(&m_mutex);
+    for (Job *job : m_jobs) {
+        job->processor->stop();
+    }
+    m_slotFreed.wakeAll();
+}
+
+void JobScheduler::run()
+{
+    m_stopRequested = false;
+    m_finishedCount = 0;
+    m_totalCount = 0;
+    m_serial = 0;
+    {
+        QMutexLocker locker(&m_mutex);
+        m_enumerationDone = false;
+    }
+
+    const int workerCount = qMax(1, m_workerCount > 0 ? m_workerCount : QThread::idealThreadCount());
+    QList<JobProfile> profiles;
+    {
+        QMutexLocker locker(&m_profilesMutex);
+        profiles = m_profiles;
+    }
+
+    QThreadPool workers;
+    workers.setMaxThreadCount(workerCount);
+
+    for (int i = 0; i < workerCount; ++i) {
+        workers.start([this]() {
+            // Jobs may run with different buffer sizes, so each keeps its own pool.
+            QHash<Job *, BufferPool *> pools;
+            Job *job = nullptr;
+            QString inputFile;
+            while (takeTask(&job, &inputFile)) {
+                BufferPool *&pool = pools[job];
+                if (!pool) {
+                    pool = new BufferPool(qMax(2, job->profile.settings.queueDepth), job->processor->bufferSize());
+                }
+                finishTask(job, job->processor->processExternalFile(inputFile, *pool));
+            }
+            qDeleteAll(pools);
+        });
+    }
+
+    // Only this thread adds jobs to m_jobs, so it reads the list without the lock.
+    // Until every tree has been enumerated the total keeps growing, and progress
+    // stays below 100.
+    QElapsedTimer reportTimer;
+    reportTimer.start();
+    qint64 lastReportMs = 0;
+    int lastProgress = -1;
+    auto report = [&]() {
+        lastReportMs = reportTimer.elapsed();
+
+        const int totalCount = m_totalCount.load();
+        int progress = totalCount > 0 ? int(qint64(m_finishedCount.load()) * 100 / totalCount) : 0;
+        if (!m_enumerationDone) {
+            progress = qMin(progress, 99);
+        }
+        if (progress != lastProgress) {
+            lastProgress = progress;
+            emit progressUpdated(progress);
+        }
+
+        for (Job *job : m_jobs) {
+            if (lastReportMs - job->lastMetricsMs < qMax(REPORT_INTERVAL_MS, job->profile.settings.metricsIntervalMs)) {
+                continue;
+            }
+            job->lastMetricsMs = lastReportMs;
+
+            QMutexLocker locker(&job->metricsMutex);
+            if (!job->finished) {
+                job->processor->publishMetrics();
+            }
+        }
+    };
+    auto reportIfDue = [&]() {
+        if (reportTimer.elapsed() - lastReportMs >= REPORT_INTERVAL_MS) {
+            report();
+        }
+    };
+
+    // Each job keeps its own checksum manifest and pack segments in its output folder,
+    // and the manifest is saved whole, so two jobs writing there would drop each other's
+    // entries. A job whose output overlaps an earlier one is not started.
+    QStringList outputPaths;
+    for (const JobProfile &profile : profiles) {
+        if (m_stopRequested) {
+            break;
+        }
+
+        const QString outputPath = QDir::cleanPath(QDir(profile.settings.outputPath).absolutePath());
+        const auto overlapping = std::find_if(outputPaths.constBegin(), outputPaths.constEnd(),
+                                              [&](const QString &path) { return pathsOverlap(outputPath, path); });
+        if (overlapping != outputPaths.constEnd()) {
+            emit errorOccurred("[" + profile.name + "] Выходная папка пересекается с папкой другого задания: "
+                               + *overlapping);
+            emit jobFinished(profile.name, 0, 0, 0);
+            continue;
+        }
+        outputPaths << outputPath;
+
+        startJob(profile, workerCount, reportIfDue);
+    }
+
+    {
+        QMutexLocker locker(&m_mutex);
+        m_enumerationDone = true;
+        m_slotFreed.wakeAll();
+    }
+
+    while (!workers.waitForDone(REPORT_INTERVAL_MS)) {
+        report();
+    }
+    report();
+
+    // Jobs left unfinished were stopped: their processors keep a checkpoint to resume from.
+    int processedCount = 0;
+    int skippedCount = 0;
+    for (Job *job : m_jobs) {
+        if (!job->finished) {
+            if (m_stopRequested) {
+                job->processor->stop();
+            }
+            job->finished = true;
+            finishJob(job);
+        }
+        processedCount += job->processedCount;
+        skippedCount += job->skippedCount;
+    }
+
+    {
+        QMutexLocker locker(&m_mutex);
+        qDeleteAll(m_jobs);
+        m_jobs.clear();
+        m_freeSlots.clear();
+    }
+
+    const int totalCount = m_totalCount.load();
+    if (m_stopRequested) {
+        emit statusUpdated("Обработка прервана пользователем");
+    } else {
+        emit statusUpdated(QString("Задания завершены. Обработано файлов: %1 из %2").arg(processedCount).arg(totalCount));
+        emit progressUpdated(100);
+    }
+
+    emit runCompleted(processedCount, skippedCount, totalCount);
+}
+
+// The job is handed to the workers before its tree is enumerated, and each file is
+// queued as soon as it is found.
+void JobScheduler::startJob(const JobProfile &profile, int workerCount, const std::function<void()> &reportIfDue)
+{
+    QScopedPointer<Job> job(new Job);
+    job->profile = profile;
+    job->profile.settings.verifyManifest = false;
+    job->processor.reset(new FileProcessor);
+
+    const QString prefix = "[" + profile.name + "] ";
+    const QString name = profile.name;
+    connect(job->processor.data(), &FileProcessor::statusUpdated, this,
+            [this, prefix](const QString &status) { emit statusUpdated(prefix + status); }, Qt::DirectConnection);
+    connect(job->processor.data(), &FileProcessor::errorOccurred, this,
+            [this, prefix](const QString &error) { emit errorOccurred(prefix + error); }, Qt::DirectConnection);
+    connect(job->processor.data(), &FileProcessor::metricsUpdated, this,
+            [this, name](const ProcessingMetrics::Snapshot &snapshot) { emit metricsUpdated(name, snapshot); },
+            Qt::DirectConnection);
+
+    job->processor->setSettings(job->profile.settings);
+    if (!job->processor->beginExternalRun()) {
+        emit jobFinished(profile.name, 0, 0, 0);
+        return;
+    }
+
+    const QString paths[] = { profile.settings.inputPath, profile.settings.outputPath };
+    for (const QString &path : paths) {
+        const QString device = deviceKey(path);
+        if (job->devices.contains(device)) {
+            continue;
+        }
+        job->devices << device;
+
+        QMutexLocker locker(&m_mutex);
+        if (!m_freeSlots.contains(device)) {
+            const int slotCount = m_deviceConcurrency > 0 ? m_deviceConcurrency
+                                                          : (BufferTuner::isRotational(path) ? 1 : workerCount);
+            m_freeSlots.insert(device, slotCount);
+        }
+    }
+
+    Job *current = job.take();
+    {
+        QMutexLocker locker(&m_mutex);
+        m_jobs.append(current);
+    }
+
+    emit statusUpdated(prefix + "Поиск файлов для обработки...");
+    FileProcessor *processor = current->processor.data();
+    processor->enumerateInputFiles([&](const QString &inputFile) {
+        if (!processor->acceptInputFile(inputFile)) {
+            ++current->skippedCount;
+        } else {
+            const qint64 size = QFileInfo(inputFile).size();
+
+            QMutexLocker locker(&m_mutex);
+            current->pending.push_back(Task{ inputFile, size, current->discoveredCount++ });
+            std::push_heap(current->pending.begin(), current->pending.end(),
+                           [this](const Task &a, const Task &b) { return takesAfter(a, b); });
+            ++m_totalCount;
+            m_slotFreed.wakeAll();
+        }
+        reportIfDue();
+        return !m_stopRequested;
+    });
+
+    if (current->skippedCount > 0) {
+        emit statusUpdated(prefix + QString("Пропущено без изменений: %1").arg(current->skippedCount));
+    }
+    emit statusUpdated(prefix + QString("Найдено файлов: %1, приоритет %2").arg(current->discoveredCount).arg(profile.priority));
+
+    // The workers may have drained the job already, in which case nobody else will end it.
+    bool jobDone = false;
+    {
+        QMutexLocker locker(&m_mutex);
+        current->enumerating = false;
+        if (isJobDone(current)) {
+            current->finished = true;
+            jobDone = true;
+        }
+        m_slotFreed.wakeAll();
+    }
+    if (jobDone) {
+        finishJob(current);
+    }
+}
+
+// Called with m_mutex held.
+bool JobScheduler::isJobDone(const Job *job) const
+{
+    return !job->enumerating && job->pending.empty() && job->running == 0 && !job->finished && !m_stopRequested;
+}
+
+// Largest first keeps the long files from being left for the end of the run, where
+// they would hold one worker while the others sit idle. Ties go in discovery order.
+bool JobScheduler::takesAfter(const Task &task, const Task &other) const
+{
+    if (m_fileOrder == LargestFirst && task.size != other.size) {
+        return task.size < other.size;
+    }
+    if (m_fileOrder == SmallestFirst && task.size != other.size) {
+        return task.size > other.size;
+    }
+    return task.order > other.order;
+}
+
+bool JobScheduler::isBetter(const Job *job, const Job *other) const
+{
+    if (job->profile.priority != other->profile.priority) {
+        return job->profile.priority > other->profile.priority;
+    }
+
+    const qint64 size = job->pending.front().size;
+    const qint64 otherSize = other->pending.front().size;
+    if (m_fileOrder == LargestFirst && size != otherSize) {
+        return size > otherSize;
+    }
+    if (m_fileOrder == SmallestFirst && size != otherSize) {
+        return size < otherSize;
+    }
+    // Otherwise the jobs take turns.
+    return job->lastServed < other->lastServed;
+}
+
+bool JobScheduler::takeTask(Job **job, QString *path)
+{
+    QMutexLocker locker(&m_mutex);
+
+    while (!m_stopRequested) {
+        Job *best = nullptr;
+        // More files may still turn up while a tree is being enumerated.
+        bool pending = !m_enumerationDone;
+
+        for (Job *candidate : m_jobs) {
+            if (candidate->pending.empty()) {
+                continue;
+            }
+            pending = true;
+
+            bool available = true;
+            for (const QString &device : candidate->devices) {
+                if (m_freeSlots.value(device) <= 0) {
+                    available = false;
+                    break;
+                }
+            }
+            if (available && (!best || isBetter(candidate, best))) {
+                best = candidate;
+            }
+        }
+
+        if (best) {
+            for (const QString &device : best->devices) {
+                --m_freeSlots[device];
+            }
+            *job = best;
+            std::pop_heap(best->pending.begin(), best->pending.end(),
+                          [this](const Task &a, const Task &b) { return takesAfter(a, b); });
+            *path = best->pending.back().path;
+            best->pending.pop_back();
+            ++best->running;
+            best->lastServed = ++m_serial;
+            return true;
+        }
+        if (!pending) {
+            return false;
+        }
+
+        m_slotFreed.wait(&m_mutex);
+    }
+
+    return false;
+}
+
+void JobScheduler::finishTask(Job *job, bool ok)
+{
+    bool jobDone = false;
+    {
+        QMutexLocker locker(&m_mutex);
+        for (const QString &device : job->devices) {
+            ++m_freeSlots[device];
+        }
+        --job->running;
+        if (ok) {
+            ++job->processedCount;
+        }
+        if (isJobDone(job)) {
+            job->finished = true;
+            jobDone = true;
+        }
+        m_slotFreed.wakeAll();
+    }
+    ++m_finishedCount;
+
+    if (jobDone) {
+        finishJob(job);
+    }
+}
+
+// The caller has marked the job finished.
+void JobScheduler::finishJob(Job *job)
+{
+    {
+        QMutexLocker locker(&job->metricsMutex);
+        job->processor->endExternalRun();
+    }
+    emit jobFinished(job->profile.name, job->processedCount, job->skippedCount, job->discoveredCount);
+}
@@ -0,0 +1,99 @@
+#ifndef JOBSCHEDULER_H
+#define JOBSCHEDULER_H
+
+#include <QThread>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QWaitCondition>
+#include <atomic>
+#include "fileprocessor.h"
+
+struct JobProfile
+{
+    QString name;
+    FileProcessorSettings settings;
+    int priority = 0;
+};
+
+// Runs several jobs on one worker pool. A free worker takes the next file of the
+// highest-priority job it may start; within a priority the file order picks the job.
+// Workers start on the first files found while the input trees are still being
+// enumerated, so the order applies to the files discovered so far.
+// Each device the jobs read from or write to has a number of slots, so jobs sharing
+// a spinning disk take turns instead of seeking against each other. Jobs need output
+// folders of their own; one nested in or equal to another's is rejected.
+class JobScheduler : public QThread
+{
+    Q_OBJECT
+
+public:
+    enum FileOrder {
+        DiscoveryOrder,
+        SmallestFirst,
+        LargestFirst
+    };
+
+    explicit JobScheduler(QObject *parent = nullptr);
+    ~JobScheduler();
+
+    void addJob(const JobProfile &job);
+    void removeJob(int index);
+    QList<JobProfile> jobs() const;
+
+    void setWorkerCount(int count);
+    void setFileOrder(FileOrder order);
+    // Files open at once per device; 0 gives spinning disks one slot and leaves
+    // other devices unlimited.
+    void setDeviceConcurrency(int limit);
+    void stop();
+
+signals:
+    void progressUpdated(int progress);
+    void statusUpdated(const QString &status);
+    void errorOccurred(const QString &error);
+    void jobFinished(const QString &name, int processedCount, int skippedCount, int totalCount);
+    void metricsUpdated(const QString &name, const ProcessingMetrics::Snapshot &snapshot);
+    void runCompleted(int processedCount, int skippedCount, int totalCount);
+
+protected:
+    void run() override;
+
+private:
+    struct Task
+    {
+        QString path;
+        qint64 size;
+        int order;
+    };
+    struct Job;
+
+    void startJob(const JobProfile &profile, int workerCount, const std::function<void()> &reportIfDue);
+    bool takeTask(Job **job, QString *path);
+    void finishTask(Job *job, bool ok);
+    void finishJob(Job *job);
+    bool isJobDone(const Job *job) const;
+    bool takesAfter(const Task &task, const Task &other) const;
+    bool isBetter(const Job *job, const Job *other) const;
+
+    mutable QMutex m_profilesMutex;
+    QList<JobProfile> m_profiles;
+    int m_workerCount;
+    FileOrder m_fileOrder;
+    int m_deviceConcurrency;
+    std::atomic<bool> m_stopRequested;
+
+    QMutex m_mutex;
+    QWaitCondition m_slotFreed;
+    QList<Job *> m_jobs;
+    QHash<QString, int> m_freeSlots;
+    quint64 m_serial;
+    bool m_enumerationDone;
+    std::atomic<int> m_finishedCount;
+    std::atomic<int> m_totalCount;
+
+    static constexpr int REPORT_INTERVAL_MS = 50;
+};
+
+#endif // JOBSCHEDULER_H
@@ -0,0 +1,77 @@
+#include "logmodel.h"
+#include <QBrush>
+#include <QDateTime>
+
+LogModel::LogModel(int capacity, QObject *parent)
+    : QAbstractListModel(parent)
+    , m_capacity(qMax(1, capacity))
+    , m_first(0)
+    , m_count(0)
+{
+    m_entries.resize(m_capacity);
+}
+
+int LogModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_count;
+}
+
+QVariant LogModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_count) {
+        return QVariant();
+    }
+
+    const Entry &entry = entryAt(index.row());
+
+    if (role == Qt::DisplayRole) {
+        const QString time = QDateTime::fromMSecsSinceEpoch(entry.timestampMs).toString("hh:mm:ss");
+        return entry.error ? QString("[%1] ОШИБКА: %2").arg(time, entry.text)
+                           : QString("[%1] %2").arg(time, entry.text);
+    }
+    if (role == Qt::ForegroundRole && entry.error) {
+        return QBrush(Qt::red);
+    }
+
+    return QVariant();
+}
+
+void LogModel::append(const QVector<Entry> &entries)
+{
+    if (entries.isEmpty()) {
+        return;
+    }
+
+    // Only the newest `m_capacity` entries of the batch can survive.
+    const int size = static_cast<int>(entries.size());
+    const int skipped = qMax(0, size - m_capacity);
+    const int incoming = size - skipped;
+
+    const int overflow = qMax(0, m_count + incoming - m_capacity);
+    if (overflow > 0) {
+        beginRemoveRows(QModelIndex(), 0, overflow - 1);
+        m_first = (m_first + overflow) % m_capacity;
+        m_count -= overflow;
+        endRemoveRows();
+    }
+
+    beginInsertRows(QModelIndex(), m_count, m_count + incoming - 1);
+    for (int i = skipped; i < size; ++i) {
+        m_entries[(m_first + m_count) % m_capacity] = entries.at(i);
+        m_count++;
+    }
+    endInsertRows();
+}
+
+void LogModel::clear()
+{
+    beginResetModel();
+    m_first = 0;
+    m_count = 0;
+    endResetModel();
+}
+
+const LogModel::Entry &LogModel::entryAt(int row) const
+{
+    return m_entries.at((m_first + row) % m_capacity);
+}
@@ -0,0 +1,39 @@
+#ifndef LOGMODEL_H
+#define LOGMODEL_H
+
+#include <QAbstractListModel>
+#include <QString>
+#include <QVector>
+
+// Bounded log: once full, the oldest entries are dropped. Timestamps are formatted
+// only for rows the view actually asks for.
+class LogModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    struct Entry
+    {
+        qint64 timestampMs = 0;
+        QString text;
+        bool error = false;
+    };
+
+    explicit LogModel(int capacity, QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+    void append(const QVector<Entry> &entries);
+    void clear();
+
+private:
+    const Entry &entryAt(int row) const;
+
+    QVector<Entry> m_entries;
+    int m_capacity;
+    int m_first;
+    int m_count;
+};
+
+#endif // LOGMODEL_H
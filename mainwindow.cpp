@@ -2,13 +2,22 @@
 #include <QMessageBox>
 #include <QStandardPaths>
 #include <QDir>
+#include <QFile>
 #include <QDateTime>
+#include <QScrollBar>
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , m_centralWidget(nullptr)
+    , m_errorCount(0)
     , m_processor(nullptr)
+    , m_scheduler(nullptr)
+    , m_jobCounter(0)
     , m_processingTimer(new QTimer(this))
+    , m_directoryWatcher(new DirectoryWatcher(this))
+    , m_watching(false)
+    , m_verifying(false)
+    , m_runningJobs(false)
 {
     setupUI();
 
@@ -16,7 +25,23 @@ MainWindow::MainWindow(QWidget *parent)
     connect(m_processor, &FileProcessor::finished, this, &MainWindow::onProcessingFinished);
     connect(m_processor, &FileProcessor::progressUpdated, this, &MainWindow::onProgressUpdate);
     connect(m_processor, &FileProcessor::statusUpdated, this, &MainWindow::onStatusUpdate);
+    connect(m_processor, &FileProcessor::currentFileChanged, this, &MainWindow::onCurrentFileChanged);
     connect(m_processor, &FileProcessor::errorOccurred, this, &MainWindow::onErrorOccurred);
+    connect(m_processor, &FileProcessor::metricsUpdated, this, &MainWindow::onMetricsUpdated);
+
+    m_scheduler = new JobScheduler(this);
+    connect(m_scheduler, &JobScheduler::finished, this, &MainWindow::onProcessingFinished);
+    connect(m_scheduler, &JobScheduler::progressUpdated, this, &MainWindow::onProgressUpdate);
+    connect(m_scheduler, &JobScheduler::statusUpdated, this, &MainWindow::onStatusUpdate);
+    connect(m_scheduler, &JobScheduler::errorOccurred, this, &MainWindow::onErrorOccurred);
+    connect(m_scheduler, &JobScheduler::jobFinished, this, &MainWindow::onJobFinished);
+    connect(m_scheduler, &JobScheduler::metricsUpdated, this,
+            [this](const QString &name, const ProcessingMetrics::Snapshot &snapshot) {
+                onMetricsUpdated(snapshot);
+                m_metricsLabel->setText("[" + name + "] " + m_metricsLabel->text());
+            });
+
+    connect(m_directoryWatcher, &DirectoryWatcher::filesReady, this, &MainWindow::onWatchedFilesReady);
 
     connect(m_processingTimer, &QTimer::timeout, this, [this]() {
         if (!m_processor->isRunning()) {
@@ -42,6 +67,10 @@ MainWindow::~MainWindow()
         m_processor->stop();
         m_processor->wait();
     }
+    if (m_scheduler && m_scheduler->isRunning()) {
+        m_scheduler->stop();
+        m_scheduler->wait();
+    }
 }
 
 void MainWindow::setupUI()
@@ -54,6 +83,7 @@ void MainWindow::setupUI()
     createInputGroup();
     createOutputGroup();
     createProcessingGroup();
+    createJobsGroup();
     createControlGroup();
     createStatusGroup();
 
@@ -77,8 +107,16 @@ void MainWindow::createInputGroup()
     m_fileMaskEdit = new QLineEdit;
     layout->addWidget(m_fileMaskEdit, 1, 1, 1, 2);
 
+    m_recursiveCheck = new QCheckBox("Включая подпапки");
+    layout->addWidget(m_recursiveCheck, 2, 0, 1, 3);
+
     m_deleteInputCheck = new QCheckBox("Удалять входные файлы после обработки");
-    layout->addWidget(m_deleteInputCheck, 2, 0, 1, 3);
+    layout->addWidget(m_deleteInputCheck, 3, 0, 1, 3);
+
+    m_inPlaceCheck = new QCheckBox("Обрабатывать на месте и переносить без копирования");
+    m_inPlaceCheck->setEnabled(false);
+    layout->addWidget(m_inPlaceCheck, 4, 0, 1, 3);
+    connect(m_deleteInputCheck, &QCheckBox::toggled, m_inPlaceCheck, &QCheckBox::setEnabled);
 
     m_mainLayout->addWidget(m_inputGroup);
 }
@@ -107,6 +145,11 @@ void MainWindow::createOutputGroup()
     radioLayout->addWidget(m_modifyNameRadio);
     layout->addLayout(radioLayout, 1, 1, 1, 2);
 
+    m_packOutputCheck = new QCheckBox("Упаковывать в сегменты (для большого числа мелких файлов)");
+    m_packOutputCheck->setToolTip("Файлы дописываются в большие файлы-сегменты с индексом; "
+                                  "для извлечения используйте fileprocessor_unpack");
+    layout->addWidget(m_packOutputCheck, 2, 0, 1, 3);
+
     m_mainLayout->addWidget(m_outputGroup);
 }
 
@@ -119,12 +162,15 @@ void MainWindow::createProcessingGroup()
     m_modeGroup = new QButtonGroup(this);
     m_onceModeRadio = new QRadioButton("Разовый запуск");
     m_timerModeRadio = new QRadioButton("По таймеру");
+    m_watchModeRadio = new QRadioButton("Наблюдение за папкой");
     m_modeGroup->addButton(m_onceModeRadio);
     m_modeGroup->addButton(m_timerModeRadio);
+    m_modeGroup->addButton(m_watchModeRadio);
 
     QHBoxLayout *modeLayout = new QHBoxLayout;
     modeLayout->addWidget(m_onceModeRadio);
     modeLayout->addWidget(m_timerModeRadio);
+    modeLayout->addWidget(m_watchModeRadio);
     layout->addLayout(modeLayout, 0, 1, 1, 2);
 
     m_timerLabel = new QLabel("Интервал опроса (сек):");
@@ -137,19 +183,126 @@ void MainWindow::createProcessingGroup()
     connect(m_timerModeRadio, &QRadioButton::toggled, m_timerLabel, &QLabel::setEnabled);
     connect(m_timerModeRadio, &QRadioButton::toggled, m_timerIntervalSpin, &QSpinBox::setEnabled);
 
-    layout->addWidget(new QLabel("Значение для XOR (8 байт):"), 2, 0);
+    layout->addWidget(new QLabel("Ключ XOR (HEX):"), 2, 0);
     m_xorValueEdit = new QLineEdit;
-    m_xorValueEdit->setMaxLength(16);
-    layout->addWidget(m_xorValueEdit, 2, 1, 1, 2);
+    m_xorValueEdit->setMaxLength(2 * XorKey::MAX_SIZE);
+    layout->addWidget(m_xorValueEdit, 2, 1);
     connect(m_xorValueEdit, &QLineEdit::textChanged, this, &MainWindow::validateXorValue);
 
-    m_xorHintLabel = new QLabel("Введите 16 HEX символов (0-9, A-F)");
+    m_keyFileBtn = new QPushButton("Из файла...");
+    layout->addWidget(m_keyFileBtn, 2, 2);
+    connect(m_keyFileBtn, &QPushButton::clicked, this, &MainWindow::browseKeyFile);
+
+    m_xorHintLabel = new QLabel("Введите HEX символы (0-9, A-F) или выберите файл ключа");
     m_xorHintLabel->setStyleSheet("color: gray; font-size: 10px;");
     layout->addWidget(m_xorHintLabel, 3, 1, 1, 2);
 
+    layout->addWidget(new QLabel("Потоков обработки:"), 4, 0);
+    m_workerCountSpin = new QSpinBox;
+    m_workerCountSpin->setRange(0, 256);
+    m_workerCountSpin->setSpecialValueText("Авто");
+    layout->addWidget(m_workerCountSpin, 4, 1);
+
+    layout->addWidget(new QLabel("Ввод-вывод:"), 5, 0);
+    m_ioEngineCombo = new QComboBox;
+    m_ioEngineCombo->addItem("Буферизованный", FileProcessorSettings::BufferedIo);
+    m_ioEngineCombo->addItem("Отображение в память", FileProcessorSettings::MemoryMappedIo);
+    m_ioEngineCombo->addItem("io_uring (Linux)", FileProcessorSettings::UringIo);
+    layout->addWidget(m_ioEngineCombo, 5, 1, 1, 2);
+
+    layout->addWidget(new QLabel("Кэш страниц:"), 6, 0);
+    m_cachePolicyCombo = new QComboBox;
+    m_cachePolicyCombo->addItem("Использовать", FileProcessorSettings::PageCache);
+    m_cachePolicyCombo->addItem("Сбрасывать после записи (fadvise)", FileProcessorSettings::DropCache);
+    m_cachePolicyCombo->addItem("Прямой ввод-вывод (O_DIRECT)", FileProcessorSettings::DirectIo);
+    layout->addWidget(m_cachePolicyCombo, 6, 1, 1, 2);
+
+    layout->addWidget(new QLabel("Размер буфера:"), 7, 0);
+    m_bufferSizeCombo = new QComboBox;
+    m_bufferSizeCombo->addItem("Авто (по устройству)", 0);
+    m_bufferSizeCombo->addItem("256 КиБ", 256 * 1024);
+    m_bufferSizeCombo->addItem("1 МиБ", 1024 * 1024);
+    m_bufferSizeCombo->addItem("4 МиБ", 4 * 1024 * 1024);
+    m_bufferSizeCombo->addItem("16 МиБ", 16 * 1024 * 1024);
+    layout->addWidget(m_bufferSizeCombo, 7, 1, 1, 2);
+
+    layout->addWidget(new QLabel("Сохранение на диск:"), 8, 0);
+    m_durabilityCombo = new QComboBox;
+    m_durabilityCombo->addItem("Без синхронизации", FileProcessorSettings::NoSync);
+    m_durabilityCombo->addItem("fdatasync для каждого файла", FileProcessorSettings::SyncEachFile);
+    m_durabilityCombo->addItem("Групповая фиксация (syncfs)", FileProcessorSettings::GroupCommit);
+    layout->addWidget(m_durabilityCombo, 8, 1, 1, 2);
+
+    m_skipUnchangedCheck = new QCheckBox("Пропускать уже обработанные неизмененные файлы");
+    layout->addWidget(m_skipUnchangedCheck, 9, 0, 1, 3);
+
+    m_indexContentHashCheck = new QCheckBox("Сверять содержимое по хешу");
+    m_indexContentHashCheck->setEnabled(false);
+    layout->addWidget(m_indexContentHashCheck, 10, 0, 1, 3);
+    connect(m_skipUnchangedCheck, &QCheckBox::toggled, m_indexContentHashCheck, &QCheckBox::setEnabled);
+
+    m_resumableCheck = new QCheckBox("Возобновлять прерванную обработку");
+    layout->addWidget(m_resumableCheck, 11, 0, 1, 3);
+
+    layout->addWidget(new QLabel("Контрольные суммы:"), 12, 0);
+    m_checksumCombo = new QComboBox;
+    m_checksumCombo->addItem("Не вычислять", Checksum::NoChecksum);
+    m_checksumCombo->addItem("CRC32C", Checksum::Crc32c);
+    m_checksumCombo->addItem("xxHash64", Checksum::XxHash64);
+    layout->addWidget(m_checksumCombo, 12, 1);
+
+    m_checksumInputCheck = new QCheckBox("И для входных файлов");
+    m_checksumInputCheck->setEnabled(false);
+    layout->addWidget(m_checksumInputCheck, 12, 2);
+    connect(m_checksumCombo, &QComboBox::currentIndexChanged, this, [this](int index) {
+        m_checksumInputCheck->setEnabled(m_checksumCombo->itemData(index).toInt() != Checksum::NoChecksum);
+    });
+
     m_mainLayout->addWidget(m_processingGroup);
 }
 
+// Jobs are snapshots of the settings above, run side by side by the scheduler.
+void MainWindow::createJobsGroup()
+{
+    m_jobsGroup = new QGroupBox("Задания", this);
+    QVBoxLayout *layout = new QVBoxLayout(m_jobsGroup);
+
+    m_jobList = new QListWidget;
+    m_jobList->setMaximumHeight(80);
+    layout->addWidget(m_jobList);
+
+    QHBoxLayout *buttonLayout = new QHBoxLayout;
+    buttonLayout->addWidget(new QLabel("Приоритет:"));
+    m_jobPrioritySpin = new QSpinBox;
+    m_jobPrioritySpin->setRange(0, 9);
+    m_jobPrioritySpin->setToolTip("Файлы задания с большим приоритетом обрабатываются раньше");
+    buttonLayout->addWidget(m_jobPrioritySpin);
+
+    buttonLayout->addWidget(new QLabel("Порядок:"));
+    m_jobOrderCombo = new QComboBox;
+    m_jobOrderCombo->addItem("Сначала крупные", JobScheduler::LargestFirst);
+    m_jobOrderCombo->addItem("Сначала мелкие", JobScheduler::SmallestFirst);
+    m_jobOrderCombo->addItem("Как найдены", JobScheduler::DiscoveryOrder);
+    m_jobOrderCombo->setToolTip("Крупные файлы в начале сокращают общее время, мелкие быстрее дают первые результаты");
+    buttonLayout->addWidget(m_jobOrderCombo);
+    buttonLayout->addStretch();
+
+    m_addJobBtn = new QPushButton("Добавить");
+    m_addJobBtn->setToolTip("Добавить задание с текущими настройками");
+    m_removeJobBtn = new QPushButton("Удалить");
+    m_runJobsBtn = new QPushButton("Запустить задания");
+    buttonLayout->addWidget(m_addJobBtn);
+    buttonLayout->addWidget(m_removeJobBtn);
+    buttonLayout->addWidget(m_runJobsBtn);
+    layout->addLayout(buttonLayout);
+
+    connect(m_addJobBtn, &QPushButton::clicked, this, &MainWindow::addJob);
+    connect(m_removeJobBtn, &QPushButton::clicked, this, &MainWindow::removeJob);
+    connect(m_runJobsBtn, &QPushButton::clicked, this, &MainWindow::startJobs);
+
+    m_mainLayout->addWidget(m_jobsGroup);
+}
+
 void MainWindow::createControlGroup()
 {
     m_controlGroup = new QGroupBox("Управление", this);
@@ -157,15 +310,20 @@ void MainWindow::createControlGroup()
 
     m_startBtn = new QPushButton("Запустить");
     m_stopBtn = new QPushButton("Остановить");
+    m_verifyBtn = new QPushButton("Проверить");
 
     m_startBtn->setMinimumHeight(40);
     m_stopBtn->setMinimumHeight(40);
+    m_verifyBtn->setMinimumHeight(40);
+    m_verifyBtn->setToolTip("Сверить выходные файлы с файлом контрольных сумм");
 
     layout->addWidget(m_startBtn);
     layout->addWidget(m_stopBtn);
+    layout->addWidget(m_verifyBtn);
 
     connect(m_startBtn, &QPushButton::clicked, this, &MainWindow::startProcessing);
     connect(m_stopBtn, &QPushButton::clicked, this, &MainWindow::stopProcessing);
+    connect(m_verifyBtn, &QPushButton::clicked, this, &MainWindow::startVerification);
 
     m_mainLayout->addWidget(m_controlGroup);
 }
@@ -181,10 +339,19 @@ void MainWindow::createStatusGroup()
     m_statusLabel = new QLabel("Готов к работе");
     layout->addWidget(m_statusLabel);
 
-    m_logEdit = new QTextEdit;
-    m_logEdit->setMaximumHeight(150);
-    m_logEdit->setReadOnly(true);
-    layout->addWidget(m_logEdit);
+    m_metricsLabel = new QLabel;
+    layout->addWidget(m_metricsLabel);
+
+    m_logModel = new LogModel(LOG_CAPACITY, this);
+    m_logView = new QListView;
+    m_logView->setModel(m_logModel);
+    m_logView->setUniformItemSizes(true);
+    m_logView->setMaximumHeight(150);
+    layout->addWidget(m_logView);
+
+    m_logFlushTimer = new QTimer(this);
+    m_logFlushTimer->setSingleShot(true);
+    connect(m_logFlushTimer, &QTimer::timeout, this, &MainWindow::flushLog);
 
     m_mainLayout->addWidget(m_statusGroup);
 }
@@ -207,46 +374,211 @@ void MainWindow::browseOutputPath()
     }
 }
 
+void MainWindow::browseKeyFile()
+{
+    if (!m_keyFilePath.isEmpty()) {
+        m_keyFilePath.clear();
+        m_keyFileBtn->setText("Из файла...");
+        m_xorValueEdit->setEnabled(true);
+        validateXorValue();
+        return;
+    }
+
+    QString filePath = QFileDialog::getOpenFileName(this, "Выберите файл ключа", m_inputPathEdit->text());
+    if (!filePath.isEmpty()) {
+        m_keyFilePath = filePath;
+        m_keyFileBtn->setText("Ввести вручную");
+        m_xorValueEdit->setEnabled(false);
+        validateXorValue();
+    }
+}
+
 void MainWindow::startProcessing()
 {
     if (!validateSettings()) {
         return;
     }
 
-    FileProcessorSettings settings;
-    settings.inputPath = m_inputPathEdit->text();
-    settings.outputPath = m_outputPathEdit->text();
-    settings.fileMask = m_fileMaskEdit->text();
-    settings.deleteInputFiles = m_deleteInputCheck->isChecked();
-    settings.overwriteOutput = m_overwriteRadio->isChecked();
-
-    QString xorText = m_xorValueEdit->text().toUpper();
-    bool ok;
-    settings.xorValue = xorText.toULongLong(&ok, 16);
+    const FileProcessorSettings settings = collectSettings();
 
     m_processor->setSettings(settings);
+    m_processor->setInputFiles(QStringList());
 
     m_startBtn->setEnabled(false);
     m_stopBtn->setEnabled(true);
+    m_verifyBtn->setEnabled(false);
+    m_runJobsBtn->setEnabled(false);
 
     m_progressBar->setValue(0);
     m_statusLabel->setText("Запуск обработки...");
 
     if (m_timerModeRadio->isChecked()) {
         m_processingTimer->start(m_timerIntervalSpin->value() * 1000);
-        m_logEdit->append(QString("[%1] Запущен режим по таймеру (интервал: %2 сек)")
-                              .arg(QDateTime::currentDateTime().toString("hh:mm:ss"))
-                              .arg(m_timerIntervalSpin->value()));
+        appendLog(QString("Запущен режим по таймеру (интервал: %1 сек)").arg(m_timerIntervalSpin->value()));
+    }
+
+    if (m_watchModeRadio->isChecked() && !m_watching) {
+        m_watching = m_directoryWatcher->start(settings.inputPath, FileProcessor::fileMaskFilters(settings.fileMask),
+                                               settings.recursive, settings.outputPath);
+        m_pendingWatchedFiles.clear();
+        appendLog(QString("Запущено наблюдение за папкой (%1)")
+                      .arg(m_directoryWatcher->usesInotify() ? "inotify" : "QFileSystemWatcher"));
+    }
+
+    m_processor->start();
+}
+
+// The key is optional here: without it only the outputs are checked.
+void MainWindow::startVerification()
+{
+    if (m_processor->isRunning() || m_scheduler->isRunning() || m_processingTimer->isActive() || m_watching) {
+        return;
+    }
+
+    if (!QFile::exists(ChecksumManifest::filePath(m_outputPathEdit->text()))) {
+        QMessageBox::warning(this, "Ошибка", "В папке для сохранения нет файла контрольных сумм");
+        return;
     }
 
+    FileProcessorSettings settings = collectSettings();
+    settings.verifyManifest = true;
+    m_processor->setSettings(settings);
+
+    m_verifying = true;
+    m_startBtn->setEnabled(false);
+    m_stopBtn->setEnabled(true);
+    m_verifyBtn->setEnabled(false);
+    m_runJobsBtn->setEnabled(false);
+
+    m_progressBar->setValue(0);
+    m_statusLabel->setText("Запуск проверки...");
+
+    m_processor->start();
+}
+
+void MainWindow::addJob()
+{
+    if (m_scheduler->isRunning() || !validateSettings()) {
+        return;
+    }
+
+    JobProfile job;
+    job.name = QString("Задание %1").arg(++m_jobCounter);
+    job.settings = collectSettings();
+    job.priority = m_jobPrioritySpin->value();
+    m_scheduler->addJob(job);
+
+    m_jobList->addItem(QString("%1: %2 (%3) → %4, приоритет %5")
+                           .arg(job.name, job.settings.inputPath, job.settings.fileMask, job.settings.outputPath)
+                           .arg(job.priority));
+}
+
+void MainWindow::removeJob()
+{
+    const int row = m_jobList->currentRow();
+    if (row < 0 || m_scheduler->isRunning()) {
+        return;
+    }
+
+    m_scheduler->removeJob(row);
+    delete m_jobList->takeItem(row);
+}
+
+void MainWindow::startJobs()
+{
+    if (m_processor->isRunning() || m_scheduler->isRunning() || m_processingTimer->isActive() || m_watching) {
+        return;
+    }
+
+    if (m_scheduler->jobs().isEmpty()) {
+        QMessageBox::warning(this, "Ошибка", "Добавьте хотя бы одно задание");
+        return;
+    }
+
+    m_scheduler->setWorkerCount(m_workerCountSpin->value());
+    m_scheduler->setFileOrder(static_cast<JobScheduler::FileOrder>(m_jobOrderCombo->currentData().toInt()));
+
+    m_runningJobs = true;
+    m_startBtn->setEnabled(false);
+    m_stopBtn->setEnabled(true);
+    m_verifyBtn->setEnabled(false);
+    m_runJobsBtn->setEnabled(false);
+    m_addJobBtn->setEnabled(false);
+    m_removeJobBtn->setEnabled(false);
+
+    m_progressBar->setValue(0);
+    m_statusLabel->setText("Запуск заданий...");
+
+    m_scheduler->start();
+}
+
+void MainWindow::onJobFinished(const QString &name, int processedCount, int skippedCount, int totalCount)
+{
+    appendLog(QString("%1 завершено. Обработано файлов: %2 из %3, пропущено: %4")
+                  .arg(name).arg(processedCount).arg(totalCount).arg(skippedCount));
+}
+
+FileProcessorSettings MainWindow::collectSettings()
+{
+    FileProcessorSettings settings;
+    settings.inputPath = m_inputPathEdit->text();
+    settings.outputPath = m_outputPathEdit->text();
+    settings.fileMask = m_fileMaskEdit->text();
+    settings.recursive = m_recursiveCheck->isChecked();
+    settings.deleteInputFiles = m_deleteInputCheck->isChecked();
+    settings.overwriteOutput = m_overwriteRadio->isChecked();
+    settings.transformInPlace = m_inPlaceCheck->isChecked();
+    settings.outputFormat = m_packOutputCheck->isChecked() ? FileProcessorSettings::PackedSegments
+                                                           : FileProcessorSettings::SeparateFiles;
+    settings.workerCount = m_workerCountSpin->value();
+    settings.ioEngine = static_cast<FileProcessorSettings::IoEngine>(m_ioEngineCombo->currentData().toInt());
+    settings.cachePolicy = static_cast<FileProcessorSettings::CachePolicy>(m_cachePolicyCombo->currentData().toInt());
+    settings.bufferSize = m_bufferSizeCombo->currentData().toLongLong();
+    settings.durability = static_cast<FileProcessorSettings::Durability>(m_durabilityCombo->currentData().toInt());
+    settings.skipUnchanged = m_skipUnchangedCheck->isChecked();
+    settings.indexContentHash = m_indexContentHashCheck->isChecked();
+    settings.resumable = m_resumableCheck->isChecked();
+    settings.checksumAlgorithm = static_cast<Checksum::Algorithm>(m_checksumCombo->currentData().toInt());
+    settings.checksumInput = m_checksumInputCheck->isChecked();
+    settings.key = currentKey(nullptr);
+    return settings;
+}
+
+void MainWindow::onWatchedFilesReady(const QStringList &files)
+{
+    for (const QString &file : files) {
+        m_pendingWatchedFiles.insert(file);
+    }
+
+    startPendingWatchedFiles();
+}
+
+void MainWindow::startPendingWatchedFiles()
+{
+    if (!m_watching || m_pendingWatchedFiles.isEmpty() || m_processor->isRunning()) {
+        return;
+    }
+
+    QStringList inputFiles = m_pendingWatchedFiles.values();
+    inputFiles.sort();
+    m_pendingWatchedFiles.clear();
+    m_processor->setInputFiles(inputFiles);
+
+    m_startBtn->setEnabled(false);
     m_processor->start();
 }
 
 void MainWindow::stopProcessing()
 {
     m_processingTimer->stop();
-
-    if (m_processor->isRunning()) {
+    m_directoryWatcher->stop();
+    m_watching = false;
+    m_pendingWatchedFiles.clear();
+
+    if (m_scheduler->isRunning()) {
+        m_scheduler->stop();
+        m_statusLabel->setText("Остановка заданий...");
+    } else if (m_processor->isRunning()) {
         m_processor->stop();
         m_statusLabel->setText("Остановка обработки...");
     } else {
@@ -257,8 +589,26 @@ void MainWindow::stopProcessing()
 void MainWindow::onProcessingFinished()
 {
     m_startBtn->setEnabled(true);
-
-    if (!m_timerModeRadio->isChecked()) {
+    // Verification reuses the processor, so it waits until no timer or watcher can restart it.
+    m_verifyBtn->setEnabled(!m_processingTimer->isActive() && !m_watching);
+    m_runJobsBtn->setEnabled(!m_processingTimer->isActive() && !m_watching);
+    m_addJobBtn->setEnabled(true);
+    m_removeJobBtn->setEnabled(true);
+    showErrorSummary();
+
+    if (m_verifying) {
+        // The processor has already reported how many files matched.
+        m_verifying = false;
+    } else if (m_runningJobs) {
+        m_runningJobs = false;
+        m_stopBtn->setEnabled(false);
+    } else if (m_watchModeRadio->isChecked()) {
+        if (!m_watching) {
+            m_statusLabel->setText("Остановлено");
+        } else {
+            startPendingWatchedFiles();
+        }
+    } else if (!m_timerModeRadio->isChecked()) {
         m_statusLabel->setText("Обработка завершена");
     } else if (!m_processingTimer->isActive()) {
         m_statusLabel->setText("Остановлено");
@@ -273,17 +623,98 @@ void MainWindow::onProgressUpdate(int progress)
 void MainWindow::onStatusUpdate(const QString &status)
 {
     m_statusLabel->setText(status);
-    m_logEdit->append(QString("[%1] %2")
-                          .arg(QDateTime::currentDateTime().toString("hh:mm:ss"))
-                          .arg(status));
+    appendLog(status);
+}
+
+void MainWindow::onCurrentFileChanged(const QString &fileName)
+{
+    if (!fileName.isEmpty()) {
+        m_statusLabel->setText(QString("Обработка: %1").arg(fileName));
+    }
 }
 
 void MainWindow::onErrorOccurred(const QString &error)
 {
-    m_logEdit->append(QString("[%1] ОШИБКА: %2")
-                          .arg(QDateTime::currentDateTime().toString("hh:mm:ss"))
-                          .arg(error));
-    QMessageBox::warning(this, "Ошибка", error);
+    appendLog(error, true);
+
+    m_errorCount++;
+    if (m_errorSamples.size() < ERROR_SAMPLE_COUNT) {
+        m_errorSamples << error;
+    }
+}
+
+void MainWindow::appendLog(const QString &text, bool error)
+{
+    LogModel::Entry entry;
+    entry.timestampMs = QDateTime::currentMSecsSinceEpoch();
+    entry.text = text;
+    entry.error = error;
+    m_pendingLog.append(entry);
+
+    if (!m_logFlushTimer->isActive()) {
+        m_logFlushTimer->start(LOG_FLUSH_INTERVAL_MS);
+    }
+}
+
+void MainWindow::flushLog()
+{
+    QScrollBar *scrollBar = m_logView->verticalScrollBar();
+    const bool atBottom = scrollBar->value() == scrollBar->maximum();
+
+    m_logModel->append(m_pendingLog);
+    m_pendingLog.clear();
+
+    if (atBottom) {
+        m_logView->scrollToBottom();
+    }
+}
+
+// One non-modal summary per run instead of a dialog per failed file; a summary that
+// is still open is updated in place.
+void MainWindow::showErrorSummary()
+{
+    if (m_errorCount == 0) {
+        return;
+    }
+
+    QString text = QString("Ошибок при обработке: %1\n\n%2").arg(m_errorCount).arg(m_errorSamples.join('\n'));
+    if (m_errorCount > m_errorSamples.size()) {
+        text += "\n...\n\nПолный список ошибок приведен в журнале.";
+    }
+
+    m_errorCount = 0;
+    m_errorSamples.clear();
+
+    if (!m_errorSummaryBox) {
+        m_errorSummaryBox = new QMessageBox(QMessageBox::Warning, "Ошибка", QString(), QMessageBox::Ok, this);
+        m_errorSummaryBox->setAttribute(Qt::WA_DeleteOnClose);
+    }
+    m_errorSummaryBox->setText(text);
+    m_errorSummaryBox->show();
+    m_errorSummaryBox->raise();
+}
+
+void MainWindow::onMetricsUpdated(const ProcessingMetrics::Snapshot &snapshot)
+{
+    qint64 stageTotal = 0;
+    for (qint64 ns : snapshot.stageNs) {
+        stageTotal += ns;
+    }
+    auto stageShare = [&](ProcessingMetrics::Stage stage) {
+        return stageTotal > 0 ? snapshot.stageNs[stage] * 100 / stageTotal : 0;
+    };
+
+    m_metricsLabel->setText(QString("%1 МБ/с | файлов: %2, ошибок: %3 | очередь: %4, в конвейере: %5 | "
+                                    "открытие %6%, чтение %7%, XOR %8%, запись %9%")
+                                .arg(snapshot.bytesPerSecond / (1024 * 1024), 0, 'f', 1)
+                                .arg(snapshot.filesProcessed)
+                                .arg(snapshot.filesFailed)
+                                .arg(snapshot.inputQueueDepth)
+                                .arg(snapshot.pipelineDepth)
+                                .arg(stageShare(ProcessingMetrics::OpenStage))
+                                .arg(stageShare(ProcessingMetrics::ReadStage))
+                                .arg(stageShare(ProcessingMetrics::TransformStage))
+                                .arg(stageShare(ProcessingMetrics::WriteStage)));
 }
 
 bool MainWindow::validateSettings()
@@ -317,32 +748,27 @@ bool MainWindow::validateSettings()
     return true;
 }
 
-QString MainWindow::getXorValueError()
+XorKey MainWindow::currentKey(QString *error)
 {
-    QString text = m_xorValueEdit->text().trimmed();
-
-    if (text.isEmpty()) {
-        return "Введите значение для XOR операции";
-    }
-
-    if (text.length() != 16) {
-        return "Значение XOR должно содержать ровно 16 символов";
-    }
-
-    for (QChar c : text) {
-        if (!c.isDigit() && !(c >= 'A' && c <= 'F') && !(c >= 'a' && c <= 'f')) {
-            return "Значение XOR должно содержать только HEX символы (0-9, A-F)";
-        }
-    }
+    return m_keyFilePath.isEmpty() ? XorKey::fromHex(m_xorValueEdit->text(), error)
+                                   : XorKey::fromFile(m_keyFilePath, error);
+}
 
-    return QString();
+QString MainWindow::getXorValueError()
+{
+    QString error;
+    currentKey(&error);
+    return error;
 }
 
 void MainWindow::validateXorValue()
 {
-    QString error = getXorValueError();
-    if (error.isEmpty()) {
-        m_xorHintLabel->setText("✓ Корректное значение");
+    QString error;
+    const XorKey key = currentKey(&error);
+    if (!key.isNull()) {
+        m_xorHintLabel->setText(m_keyFilePath.isEmpty()
+                                    ? QString("✓ Корректное значение (%1 байт)").arg(key.size())
+                                    : QString("✓ %1 (%2 байт)").arg(QFileInfo(m_keyFilePath).fileName()).arg(key.size()));
         m_xorHintLabel->setStyleSheet("color: green; font-size: 10px;");
     } else {
         m_xorHintLabel->setText(error);
@@ -12,13 +12,21 @@
 #include <QCheckBox>
 #include <QRadioButton>
 #include <QSpinBox>
+#include <QComboBox>
 #include <QLabel>
 #include <QProgressBar>
-#include <QTextEdit>
+#include <QListView>
+#include <QListWidget>
+#include <QMessageBox>
+#include <QPointer>
 #include <QFileDialog>
 #include <QTimer>
 #include <QButtonGroup>
+#include <QSet>
 #include "fileprocessor.h"
+#include "jobscheduler.h"
+#include "directorywatcher.h"
+#include "logmodel.h"
 
 class MainWindow : public QMainWindow
 {
@@ -31,24 +39,40 @@ public:
 private slots:
     void browseInputPath();
     void browseOutputPath();
+    void browseKeyFile();
     void startProcessing();
     void stopProcessing();
+    void startVerification();
+    void addJob();
+    void removeJob();
+    void startJobs();
+    void onJobFinished(const QString &name, int processedCount, int skippedCount, int totalCount);
     void onProcessingFinished();
     void onProgressUpdate(int progress);
     void onStatusUpdate(const QString &status);
+    void onCurrentFileChanged(const QString &fileName);
     void onErrorOccurred(const QString &error);
+    void onMetricsUpdated(const ProcessingMetrics::Snapshot &snapshot);
     void validateXorValue();
+    void onWatchedFilesReady(const QStringList &files);
 
 private:
     void setupUI();
     void createInputGroup();
     void createOutputGroup();
     void createProcessingGroup();
+    void createJobsGroup();
     void createControlGroup();
     void createStatusGroup();
 
+    void startPendingWatchedFiles();
+    void appendLog(const QString &text, bool error = false);
+    void flushLog();
+    void showErrorSummary();
     bool validateSettings();
+    FileProcessorSettings collectSettings();
     QString getXorValueError();
+    XorKey currentKey(QString *error);
 
     QWidget *m_centralWidget;
     QVBoxLayout *m_mainLayout;
@@ -57,7 +81,9 @@ private:
     QLineEdit *m_inputPathEdit;
     QPushButton *m_browseInputBtn;
     QLineEdit *m_fileMaskEdit;
+    QCheckBox *m_recursiveCheck;
     QCheckBox *m_deleteInputCheck;
+    QCheckBox *m_inPlaceCheck;
 
     QGroupBox *m_outputGroup;
     QLineEdit *m_outputPathEdit;
@@ -65,27 +91,69 @@ private:
     QButtonGroup *m_fileExistsGroup;
     QRadioButton *m_overwriteRadio;
     QRadioButton *m_modifyNameRadio;
+    QCheckBox *m_packOutputCheck;
 
     QGroupBox *m_processingGroup;
     QButtonGroup *m_modeGroup;
     QRadioButton *m_timerModeRadio;
     QRadioButton *m_onceModeRadio;
+    QRadioButton *m_watchModeRadio;
     QSpinBox *m_timerIntervalSpin;
     QLabel *m_timerLabel;
     QLineEdit *m_xorValueEdit;
+    QPushButton *m_keyFileBtn;
+    QString m_keyFilePath;
     QLabel *m_xorHintLabel;
+    QSpinBox *m_workerCountSpin;
+    QComboBox *m_ioEngineCombo;
+    QComboBox *m_cachePolicyCombo;
+    QComboBox *m_bufferSizeCombo;
+    QComboBox *m_durabilityCombo;
+    QCheckBox *m_skipUnchangedCheck;
+    QCheckBox *m_indexContentHashCheck;
+    QCheckBox *m_resumableCheck;
+    QComboBox *m_checksumCombo;
+    QCheckBox *m_checksumInputCheck;
+
+    QGroupBox *m_jobsGroup;
+    QListWidget *m_jobList;
+    QSpinBox *m_jobPrioritySpin;
+    QComboBox *m_jobOrderCombo;
+    QPushButton *m_addJobBtn;
+    QPushButton *m_removeJobBtn;
+    QPushButton *m_runJobsBtn;
 
     QGroupBox *m_controlGroup;
     QPushButton *m_startBtn;
     QPushButton *m_stopBtn;
+    QPushButton *m_verifyBtn;
 
     QGroupBox *m_statusGroup;
     QProgressBar *m_progressBar;
     QLabel *m_statusLabel;
-    QTextEdit *m_logEdit;
+    QLabel *m_metricsLabel;
+    QListView *m_logView;
+    LogModel *m_logModel;
+    QVector<LogModel::Entry> m_pendingLog;
+    QTimer *m_logFlushTimer;
+
+    int m_errorCount;
+    QStringList m_errorSamples;
+    QPointer<QMessageBox> m_errorSummaryBox;
 
     FileProcessor *m_processor;
+    JobScheduler *m_scheduler;
+    int m_jobCounter;
     QTimer *m_processingTimer;
+    DirectoryWatcher *m_directoryWatcher;
+    QSet<QString> m_pendingWatchedFiles;
+    bool m_watching;
+    bool m_verifying;
+    bool m_runningJobs;
+
+    static const int LOG_CAPACITY = 10000;
+    static const int LOG_FLUSH_INTERVAL_MS = 50;
+    static const int ERROR_SAMPLE_COUNT = 5;
 };
 
 #endif // MAINWINDOW_H
@@ -0,0 +1,134 @@
+#include "outputnameindex.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+
+OutputNameIndex::OutputNameIndex(const QString &partSuffix)
+    : m_partSuffix(partSuffix)
+{
+}
+
+void OutputNameIndex::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_scannedDirectories.clear();
+    m_names.clear();
+    m_placeholders.clear();
+}
+
+QString OutputNameIndex::reserve(const QString &filePath)
+{
+    const QFileInfo fileInfo(filePath);
+    const QString dirPath = fileInfo.absolutePath();
+    const QString baseName = fileInfo.completeBaseName();
+    const QString extension = fileInfo.suffix();
+
+    QMutexLocker locker(&m_mutex);
+
+    if (!m_scannedDirectories.contains(dirPath)) {
+        scanDirectory(dirPath);
+        m_scannedDirectories.insert(dirPath);
+    }
+
+    NameState &state = m_names[nameKey(dirPath, baseName, extension)];
+    bool exists = false;
+
+    if (!state.plainTaken) {
+        state.plainTaken = true;
+        if (createPlaceholder(fileInfo.absoluteFilePath() + m_partSuffix, &exists) || !exists) {
+            return fileInfo.absoluteFilePath();
+        }
+    }
+
+    // The listing can be stale when other writers share the directory; a name they
+    // took in the meantime fails the exclusive create and the next counter is tried.
+    // A final name that appears only after the create is caught when the output is
+    // published, which refuses to replace it.
+    const QDir dir(dirPath);
+    QString candidate;
+    for (int attempt = 0; attempt < MAX_ATTEMPTS; ++attempt) {
+        candidate = dir.absoluteFilePath(numberedName(baseName, extension, ++state.highestCounter));
+        if (QFile::exists(candidate)) {
+            continue;
+        }
+        if (createPlaceholder(candidate + m_partSuffix, &exists) || !exists) {
+            break;
+        }
+    }
+    return candidate;
+}
+
+// A temporary file that holds data, such as a stopped output the checkpoint can
+// continue, is left alone.
+void OutputNameIndex::release(const QString &filePath)
+{
+    const QString partPath = filePath + m_partSuffix;
+
+    QMutexLocker locker(&m_mutex);
+    if (m_placeholders.remove(partPath) && QFileInfo(partPath).size() == 0) {
+        QFile::remove(partPath);
+    }
+}
+
+void OutputNameIndex::scanDirectory(const QString &dirPath)
+{
+    const QStringList fileNames = QDir(dirPath).entryList(QDir::Files | QDir::Hidden | QDir::System);
+    for (const QString &fileName : fileNames) {
+        recordName(dirPath, fileName);
+    }
+}
+
+// "a_3.txt" is both the plain name of base "a_3" and counter 3 of base "a".
+void OutputNameIndex::recordName(const QString &dirPath, const QString &fileName)
+{
+    // A temporary file holds its final name as well.
+    const QFileInfo fileInfo(fileName.endsWith(m_partSuffix) ? fileName.left(fileName.size() - m_partSuffix.size())
+                                                             : fileName);
+    const QString baseName = fileInfo.completeBaseName();
+    const QString extension = fileInfo.suffix();
+
+    m_names[nameKey(dirPath, baseName, extension)].plainTaken = true;
+
+    const int separator = baseName.lastIndexOf('_');
+    if (separator < 0 || separator == baseName.size() - 1) {
+        return;
+    }
+
+    bool ok = false;
+    const int counter = baseName.mid(separator + 1).toInt(&ok);
+    if (!ok || counter <= 0 || !baseName.at(separator + 1).isDigit()) {
+        return;
+    }
+
+    NameState &state = m_names[nameKey(dirPath, baseName.left(separator), extension)];
+    state.highestCounter = qMax(state.highestCounter, counter);
+}
+
+// NewOnly opens with O_CREAT | O_EXCL, so of several writers exactly one gets the name.
+bool OutputNameIndex::createPlaceholder(const QString &filePath, bool *exists)
+{
+    QFile file(filePath);
+    if (file.open(QIODevice::WriteOnly | QIODevice::NewOnly)) {
+        file.close();
+        m_placeholders.insert(filePath);
+        *exists = false;
+        return true;
+    }
+
+    // Any other failure, such as a read-only directory, shows up again when the output
+    // is written, so the name is handed out without a placeholder.
+    *exists = QFile::exists(filePath);
+    return false;
+}
+
+QString OutputNameIndex::nameKey(const QString &dirPath, const QString &baseName, const QString &extension)
+{
+    return dirPath + '/' + baseName + QChar(0) + extension;
+}
+
+QString OutputNameIndex::numberedName(const QString &baseName, const QString &extension, int counter)
+{
+    return extension.isEmpty() ? QString("%1_%2").arg(baseName).arg(counter)
+                               : QString("%1_%2.%3").arg(baseName).arg(counter).arg(extension);
+}
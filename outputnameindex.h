@@ -0,0 +1,49 @@
+#ifndef OUTPUTNAMEINDEX_H
+#define OUTPUTNAMEINDEX_H
+
+#include <QHash>
+#include <QMutex>
+#include <QSet>
+#include <QString>
+
+// Free output names for runs that must not overwrite: name.ext, then name_1.ext,
+// name_2.ext and so on. Each output directory is listed once per run to find the
+// highest counter of every base name, so a new name costs no probing. The final name
+// itself stays free until the output is complete: what is created with O_EXCL is the
+// temporary file the output is written to, name.ext plus the part suffix.
+class OutputNameIndex
+{
+public:
+    explicit OutputNameIndex(const QString &partSuffix);
+
+    void clear();
+
+    QString reserve(const QString &filePath);
+    // Removes the temporary file of a name if nothing was ever written to it.
+    void release(const QString &filePath);
+
+private:
+    struct NameState
+    {
+        bool plainTaken = false;
+        int highestCounter = 0;
+    };
+
+    void scanDirectory(const QString &dirPath);
+    void recordName(const QString &dirPath, const QString &fileName);
+    bool createPlaceholder(const QString &filePath, bool *exists);
+
+    static QString nameKey(const QString &dirPath, const QString &baseName, const QString &extension);
+    static QString numberedName(const QString &baseName, const QString &extension, int counter);
+
+    QString m_partSuffix;
+
+    QMutex m_mutex;
+    QSet<QString> m_scannedDirectories;
+    QHash<QString, NameState> m_names;
+    QSet<QString> m_placeholders;
+
+    static constexpr int MAX_ATTEMPTS = 1000;
+};
+
+#endif // OUTPUTNAMEINDEX_H
@@ -0,0 +1,538 @@
+#include "packarchive.h"
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QtEndian>
+#include <algorithm>
+#include <cstring>
+
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char SEGMENT_PREFIX[] = "segment-";
+const char SEGMENT_SUFFIX[] = ".xorpack";
+const char INDEX_SUFFIX[] = ".xorindex";
+
+const quint32 SEGMENT_MAGIC = 0x58504b53;
+const quint32 INDEX_MAGIC = 0x58504b49;
+const quint32 ENTRY_MAGIC = 0x58504b45;
+const quint32 PACK_VERSION = 1;
+
+const qint64 SEGMENT_HEADER_SIZE = 8;
+const qint64 ENTRY_HEADER_SIZE = 16;
+const qint64 WRITE_BUFFER_SIZE = 8 * 1024 * 1024;
+const qint64 READ_BUFFER_SIZE = 1024 * 1024;
+
+QString segmentPathFor(const QString &directory, int number)
+{
+    return QDir(directory).absoluteFilePath(
+        QString("%1%2%3").arg(SEGMENT_PREFIX).arg(number, 6, 10, QChar('0')).arg(SEGMENT_SUFFIX));
+}
+
+QString indexPathFor(const QString &segmentPath)
+{
+    return segmentPath.left(segmentPath.size() - int(qstrlen(SEGMENT_SUFFIX))) + INDEX_SUFFIX;
+}
+
+bool syncFile(QFile &file)
+{
+    if (!file.flush()) {
+        return false;
+    }
+#if defined(Q_OS_LINUX)
+    return ::fdatasync(file.handle()) == 0;
+#elif defined(Q_OS_UNIX)
+    return ::fsync(file.handle()) == 0;
+#else
+    return true;
+#endif
+}
+
+// A new segment is only durable once its directory entry is.
+bool syncDirectory(const QString &path)
+{
+#ifdef Q_OS_UNIX
+    const int fd = ::open(QFile::encodeName(path).constData(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    const bool ok = ::fsync(fd) == 0;
+    ::close(fd);
+    return ok;
+#else
+    Q_UNUSED(path)
+    return true;
+#endif
+}
+
+void setError(QString *error, const QString &text)
+{
+    if (error) {
+        *error = text;
+    }
+}
+
+} // namespace
+
+PackWriter::PackWriter(const QString &directory, qint64 segmentSize)
+    : m_directory(QDir(directory).absolutePath())
+    , m_segmentSize(segmentSize > 0 ? segmentSize : DEFAULT_SEGMENT_SIZE)
+    , m_segmentNumber(0)
+    , m_directoryChanged(false)
+    , m_bufferUsed(0)
+    , m_flushedSize(0)
+    , m_segmentUsed(0)
+    , m_entryStart(0)
+    , m_entryDataOffset(0)
+    , m_entrySize(0)
+    , m_entryWritten(0)
+    , m_entryChecksum(Checksum::Crc32c)
+{
+}
+
+PackWriter::~PackWriter()
+{
+    close();
+}
+
+bool PackWriter::isPackFile(const QString &filePath)
+{
+    return filePath.endsWith(SEGMENT_SUFFIX) || filePath.endsWith(INDEX_SUFFIX);
+}
+
+bool PackWriter::open()
+{
+    QMutexLocker locker(&m_mutex);
+
+    const QStringList segments = QDir(m_directory).entryList(
+        QStringList() << QString(SEGMENT_PREFIX) + '*' + SEGMENT_SUFFIX, QDir::Files);
+    for (const QString &segment : segments) {
+        const QString number = segment.mid(int(qstrlen(SEGMENT_PREFIX)),
+                                           segment.size() - int(qstrlen(SEGMENT_PREFIX) + qstrlen(SEGMENT_SUFFIX)));
+        m_segmentNumber = qMax(m_segmentNumber, number.toInt());
+    }
+
+    // The segment itself is only created by the first entry, so a run that packs
+    // nothing leaves no empty segment behind.
+    m_segment.setFileName(segmentPathFor(m_directory, m_segmentNumber + 1));
+    m_buffer.resize(WRITE_BUFFER_SIZE);
+    return QFileInfo(m_directory).isWritable();
+}
+
+bool PackWriter::flush(bool durable)
+{
+    QMutexLocker locker(&m_mutex);
+    if (!m_segment.isOpen()) {
+        return true;
+    }
+
+    // Data before index, so an index entry never gets ahead of the bytes it points to.
+    bool ok = flushBuffer() && m_index.flush();
+    if (ok && durable) {
+        ok = syncFile(m_segment) && syncFile(m_index);
+        if (ok && m_directoryChanged) {
+            ok = syncDirectory(m_directory);
+            m_directoryChanged = !ok;
+        }
+    }
+    return ok;
+}
+
+bool PackWriter::close()
+{
+    QMutexLocker locker(&m_mutex);
+    if (!m_segment.isOpen()) {
+        return true;
+    }
+
+    // A segment whose only entry was rolled back holds nothing worth keeping.
+    const bool empty = m_segmentUsed <= SEGMENT_HEADER_SIZE;
+    bool ok = closeSegment(!empty);
+    if (empty) {
+        QFile::remove(m_index.fileName());
+        QFile::remove(m_segment.fileName());
+    }
+    ok = ok && (!m_directoryChanged || syncDirectory(m_directory));
+    m_directoryChanged = false;
+    m_buffer.clear();
+    m_buffer.shrink_to_fit();
+    return ok;
+}
+
+QString PackWriter::segmentPath() const
+{
+    return m_segment.fileName();
+}
+
+bool PackWriter::append(const QString &name, const char *data, qint64 size)
+{
+    QMutexLocker locker(&m_mutex);
+
+    if (!startEntry(name, size)) {
+        return false;
+    }
+
+    m_entryChecksum.update(data, size);
+    m_entryWritten = size;
+    if (!writeBytes(data, size) || !endEntry()) {
+        rollbackEntry();
+        return false;
+    }
+    return true;
+}
+
+bool PackWriter::beginEntry(const QString &name, qint64 size)
+{
+    m_mutex.lock();
+    if (!startEntry(name, size)) {
+        m_mutex.unlock();
+        return false;
+    }
+    return true;
+}
+
+bool PackWriter::writeEntryData(const char *data, qint64 size)
+{
+    if (m_entryWritten + size > m_entrySize) {
+        return false;
+    }
+
+    m_entryChecksum.update(data, size);
+    m_entryWritten += size;
+    return writeBytes(data, size);
+}
+
+bool PackWriter::finishEntry()
+{
+    const bool ok = endEntry();
+    if (!ok) {
+        rollbackEntry();
+    }
+    m_mutex.unlock();
+    return ok;
+}
+
+void PackWriter::abortEntry()
+{
+    rollbackEntry();
+    m_mutex.unlock();
+}
+
+bool PackWriter::openSegment()
+{
+    ++m_segmentNumber;
+    const QString path = segmentPathFor(m_directory, m_segmentNumber);
+
+    m_segment.setFileName(path);
+    m_index.setFileName(indexPathFor(path));
+    if (!m_segment.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Unbuffered)
+        || !m_index.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        m_segment.close();
+        return false;
+    }
+    m_directoryChanged = true;
+
+    m_bufferUsed = 0;
+    m_flushedSize = 0;
+    m_segmentUsed = 0;
+
+    char header[SEGMENT_HEADER_SIZE];
+    qToLittleEndian<quint32>(SEGMENT_MAGIC, header);
+    qToLittleEndian<quint32>(PACK_VERSION, header + 4);
+    if (!writeBytes(header, SEGMENT_HEADER_SIZE)) {
+        return false;
+    }
+
+    m_indexStream.setDevice(&m_index);
+    m_indexStream << INDEX_MAGIC << PACK_VERSION;
+    return m_indexStream.status() == QDataStream::Ok;
+}
+
+bool PackWriter::closeSegment(bool durable)
+{
+    bool ok = flushBuffer() && m_index.flush();
+    if (ok && durable) {
+        ok = syncFile(m_segment) && syncFile(m_index);
+    }
+
+    m_indexStream.setDevice(nullptr);
+    m_index.close();
+    m_segment.close();
+    return ok;
+}
+
+bool PackWriter::startEntry(const QString &name, qint64 size)
+{
+    if (m_buffer.empty() || size < 0) {
+        return false;
+    }
+    if (!m_segment.isOpen() && !openSegment()) {
+        return false;
+    }
+
+    m_entryName = name.toUtf8();
+    const qint64 recordSize = ENTRY_HEADER_SIZE + m_entryName.size() + size;
+
+    // A full segment is closed and synced before the next one starts; rotations are rare
+    // enough that the sync costs nothing noticeable.
+    if (m_segmentUsed > SEGMENT_HEADER_SIZE && m_segmentUsed + recordSize > m_segmentSize) {
+        if (!closeSegment(true) || !openSegment()) {
+            return false;
+        }
+    }
+
+    m_entryStart = m_segmentUsed;
+    m_entryDataOffset = m_entryStart + ENTRY_HEADER_SIZE + m_entryName.size();
+    m_entrySize = size;
+    m_entryWritten = 0;
+    m_entryChecksum.reset();
+
+    char header[ENTRY_HEADER_SIZE];
+    qToLittleEndian<quint32>(ENTRY_MAGIC, header);
+    qToLittleEndian<quint32>(quint32(m_entryName.size()), header + 4);
+    qToLittleEndian<qint64>(size, header + 8);
+    if (!writeBytes(header, ENTRY_HEADER_SIZE) || !writeBytes(m_entryName.constData(), m_entryName.size())) {
+        rollbackEntry();
+        return false;
+    }
+    return true;
+}
+
+bool PackWriter::endEntry()
+{
+    if (m_entryWritten != m_entrySize) {
+        return false;
+    }
+
+    m_indexStream << m_entryName << m_entryDataOffset << m_entrySize << quint32(m_entryChecksum.value());
+    return m_indexStream.status() == QDataStream::Ok;
+}
+
+// Drops the entry in progress; whatever of it already reached the file is cut off.
+void PackWriter::rollbackEntry()
+{
+    if (m_entryStart >= m_flushedSize) {
+        m_bufferUsed -= m_segmentUsed - m_entryStart;
+    } else {
+        m_bufferUsed = 0;
+        m_segment.resize(m_entryStart);
+        m_segment.seek(m_entryStart);
+        m_flushedSize = m_entryStart;
+    }
+    m_segmentUsed = m_entryStart;
+}
+
+bool PackWriter::writeBytes(const char *data, qint64 size)
+{
+    const qint64 capacity = qint64(m_buffer.size());
+    if (m_bufferUsed + size > capacity && !flushBuffer()) {
+        return false;
+    }
+
+    // Anything at least a buffer long goes straight to the file instead of being copied.
+    if (size >= capacity) {
+        if (m_segment.write(data, size) != size) {
+            discardUnflushed();
+            return false;
+        }
+        m_flushedSize += size;
+    } else {
+        std::memcpy(m_buffer.data() + m_bufferUsed, data, size);
+        m_bufferUsed += size;
+    }
+
+    m_segmentUsed += size;
+    return true;
+}
+
+bool PackWriter::flushBuffer()
+{
+    if (m_bufferUsed == 0) {
+        return true;
+    }
+    if (m_segment.write(m_buffer.data(), m_bufferUsed) != m_bufferUsed) {
+        discardUnflushed();
+        return false;
+    }
+    m_flushedSize += m_bufferUsed;
+    m_bufferUsed = 0;
+    return true;
+}
+
+// A short write leaves part of its bytes in the file past m_flushedSize. They are cut
+// off, so the file ends where the accounting says it does and the next write, or a
+// rollback, continues from there instead of after the torn tail.
+void PackWriter::discardUnflushed()
+{
+    m_segment.resize(m_flushedSize);
+    m_segment.seek(m_flushedSize);
+}
+
+PackReader::PackReader(const QString &path)
+    : m_path(path)
+{
+}
+
+bool PackReader::load(QString *error)
+{
+    m_entries.clear();
+    m_latest.clear();
+
+    QStringList segments;
+    if (QFileInfo(m_path).isDir()) {
+        QDir dir(m_path);
+        const QStringList names = dir.entryList(
+            QStringList() << QString(SEGMENT_PREFIX) + '*' + SEGMENT_SUFFIX, QDir::Files, QDir::Name);
+        for (const QString &name : names) {
+            segments << dir.absoluteFilePath(name);
+        }
+    } else {
+        segments << QFileInfo(m_path).absoluteFilePath();
+    }
+
+    if (segments.isEmpty()) {
+        setError(error, "Сегменты упакованного вывода не найдены: " + m_path);
+        return false;
+    }
+
+    for (const QString &segment : segments) {
+        if (!loadSegment(segment, error)) {
+            return false;
+        }
+    }
+
+    for (int i = 0; i < m_entries.size(); ++i) {
+        m_latest.insert(m_entries.at(i).name, i);
+    }
+    return true;
+}
+
+QVector<PackReader::Entry> PackReader::latestEntries() const
+{
+    QVector<int> indexes;
+    indexes.reserve(m_latest.size());
+    for (int index : m_latest) {
+        indexes.append(index);
+    }
+    std::sort(indexes.begin(), indexes.end());
+
+    QVector<Entry> entries;
+    entries.reserve(indexes.size());
+    for (int index : indexes) {
+        entries.append(m_entries.at(index));
+    }
+    return entries;
+}
+
+bool PackReader::find(const QString &name, Entry *entry) const
+{
+    const auto it = m_latest.constFind(name);
+    if (it == m_latest.constEnd()) {
+        return false;
+    }
+    *entry = m_entries.at(it.value());
+    return true;
+}
+
+bool PackReader::read(const Entry &entry, QIODevice *output, QString *error) const
+{
+    QFile segment(entry.segmentPath);
+    if (!segment.open(QIODevice::ReadOnly | QIODevice::Unbuffered) || !segment.seek(entry.offset)) {
+        setError(error, "Не удалось открыть сегмент: " + entry.segmentPath);
+        return false;
+    }
+
+    std::vector<char> buffer(size_t(qMin(READ_BUFFER_SIZE, qMax<qint64>(entry.size, 1))));
+    Checksum checksum(Checksum::Crc32c);
+    qint64 remaining = entry.size;
+    while (remaining > 0) {
+        const qint64 length = qMin(remaining, qint64(buffer.size()));
+        if (segment.read(buffer.data(), length) != length) {
+            setError(error, "Не удалось прочитать запись: " + entry.name);
+            return false;
+        }
+        checksum.update(buffer.data(), length);
+        if (output->write(buffer.data(), length) != length) {
+            setError(error, "Не удалось записать запись: " + entry.name);
+            return false;
+        }
+        remaining -= length;
+    }
+
+    if (entry.hasChecksum && quint32(checksum.value()) != entry.checksum) {
+        setError(error, "Контрольная сумма записи не совпадает: " + entry.name);
+        return false;
+    }
+    return true;
+}
+
+bool PackReader::loadSegment(const QString &segmentPath, QString *error)
+{
+    QFile segment(segmentPath);
+    char header[ENTRY_HEADER_SIZE];
+    if (!segment.open(QIODevice::ReadOnly) || segment.read(header, SEGMENT_HEADER_SIZE) != SEGMENT_HEADER_SIZE
+        || qFromLittleEndian<quint32>(header) != SEGMENT_MAGIC
+        || qFromLittleEndian<quint32>(header + 4) != PACK_VERSION) {
+        setError(error, "Файл не является сегментом упакованного вывода: " + segmentPath);
+        return false;
+    }
+    const qint64 segmentSize = segment.size();
+
+    // Index entries are trusted only as far as the segment really holds their data.
+    qint64 scanFrom = SEGMENT_HEADER_SIZE;
+    QFile index(indexPathFor(segmentPath));
+    if (index.open(QIODevice::ReadOnly)) {
+        QDataStream stream(&index);
+        quint32 magic = 0;
+        quint32 version = 0;
+        stream >> magic >> version;
+        while (stream.status() == QDataStream::Ok && magic == INDEX_MAGIC && version == PACK_VERSION
+               && !stream.atEnd()) {
+            QByteArray name;
+            Entry entry;
+            stream >> name >> entry.offset >> entry.size >> entry.checksum;
+            if (stream.status() != QDataStream::Ok || entry.offset < SEGMENT_HEADER_SIZE || entry.size < 0
+                || entry.offset + entry.size > segmentSize) {
+                break;
+            }
+            entry.name = QString::fromUtf8(name);
+            entry.segmentPath = segmentPath;
+            entry.hasChecksum = true;
+            m_entries.append(entry);
+            scanFrom = entry.offset + entry.size;
+        }
+    }
+
+    // Entries written after the index was last flushed are found from their headers.
+    qint64 position = scanFrom;
+    while (position + ENTRY_HEADER_SIZE <= segmentSize) {
+        if (!segment.seek(position) || segment.read(header, ENTRY_HEADER_SIZE) != ENTRY_HEADER_SIZE
+            || qFromLittleEndian<quint32>(header) != ENTRY_MAGIC) {
+            break;
+        }
+
+        const qint64 nameSize = qFromLittleEndian<quint32>(header + 4);
+        Entry entry;
+        entry.size = qFromLittleEndian<qint64>(header + 8);
+        entry.offset = position + ENTRY_HEADER_SIZE + nameSize;
+        if (entry.size < 0 || entry.offset + entry.size > segmentSize) {
+            break;
+        }
+
+        const QByteArray name = segment.read(nameSize);
+        if (name.size() != nameSize) {
+            break;
+        }
+        entry.name = QString::fromUtf8(name);
+        entry.segmentPath = segmentPath;
+        m_entries.append(entry);
+        position = entry.offset + entry.size;
+    }
+
+    return true;
+}
@@ -0,0 +1,116 @@
+#ifndef PACKARCHIVE_H
+#define PACKARCHIVE_H
+
+#include <QDataStream>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+#include <vector>
+#include "checksum.h"
+
+class QIODevice;
+
+// Packed output: processed files appended back to back into large segment files,
+//
+//     segment-000001.xorpack    header, then per entry: magic, name size, data size, name, data
+//     segment-000001.xorindex   header, then per entry: name, data offset, data size, CRC32C
+//
+// Each run that packs anything starts a new segment, so a segment torn by a crash is never appended to.
+// The index is only a shortcut: entries it lost can be recovered by scanning the
+// headers in the segment, just without a checksum.
+class PackWriter
+{
+public:
+    static constexpr qint64 DEFAULT_SEGMENT_SIZE = 1024LL * 1024 * 1024;
+
+    PackWriter(const QString &directory, qint64 segmentSize);
+    ~PackWriter();
+
+    static bool isPackFile(const QString &filePath);
+
+    bool open();
+    // Hands buffered entries to the system; a durable flush also waits for the disk.
+    bool flush(bool durable);
+    bool close();
+
+    // Before the first entry of a run, the segment that entry will create.
+    QString segmentPath() const;
+
+    bool append(const QString &name, const char *data, qint64 size);
+
+    // Streams an entry too large to hold in memory. The writer stays locked from
+    // beginEntry until finishEntry or abortEntry, so other entries wait meanwhile.
+    bool beginEntry(const QString &name, qint64 size);
+    bool writeEntryData(const char *data, qint64 size);
+    bool finishEntry();
+    void abortEntry();
+
+private:
+    bool openSegment();
+    bool closeSegment(bool durable);
+    bool startEntry(const QString &name, qint64 size);
+    bool endEntry();
+    void rollbackEntry();
+    bool writeBytes(const char *data, qint64 size);
+    bool flushBuffer();
+    void discardUnflushed();
+
+    QString m_directory;
+    qint64 m_segmentSize;
+
+    QMutex m_mutex;
+    QFile m_segment;
+    QFile m_index;
+    QDataStream m_indexStream;
+    int m_segmentNumber;
+    bool m_directoryChanged;
+
+    std::vector<char> m_buffer;
+    qint64 m_bufferUsed;
+    qint64 m_flushedSize;
+    qint64 m_segmentUsed;
+
+    qint64 m_entryStart;
+    qint64 m_entryDataOffset;
+    qint64 m_entrySize;
+    qint64 m_entryWritten;
+    QByteArray m_entryName;
+    Checksum m_entryChecksum;
+};
+
+class PackReader
+{
+public:
+    struct Entry
+    {
+        QString name;
+        QString segmentPath;
+        qint64 offset = 0;
+        qint64 size = 0;
+        quint32 checksum = 0;
+        bool hasChecksum = false;
+    };
+
+    // The path is either a directory of segments or a single segment file.
+    explicit PackReader(const QString &path);
+
+    bool load(QString *error);
+
+    const QVector<Entry> &entries() const { return m_entries; }
+    // A name packed more than once resolves to its newest entry.
+    QVector<Entry> latestEntries() const;
+    bool find(const QString &name, Entry *entry) const;
+
+    bool read(const Entry &entry, QIODevice *output, QString *error) const;
+
+private:
+    bool loadSegment(const QString &segmentPath, QString *error);
+
+    QString m_path;
+    QVector<Entry> m_entries;
+    QHash<QString, int> m_latest;
+};
+
+#endif // PACKARCHIVE_H
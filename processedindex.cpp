@@ -0,0 +1,238 @@
+#include "processedindex.h"
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <cstring>
+
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#endif
+
+namespace {
+
+const quint32 INDEX_MAGIC = 0x58494458;
+const quint32 INDEX_VERSION = 1;
+
+quint64 hashFileContent(const QString &path, bool *ok)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        *ok = false;
+        return 0;
+    }
+
+    QCryptographicHash hash(QCryptographicHash::Md5);
+    if (!hash.addData(&file)) {
+        *ok = false;
+        return 0;
+    }
+
+    const QByteArray digest = hash.result();
+    quint64 value = 0;
+    std::memcpy(&value, digest.constData(), sizeof(value));
+    *ok = true;
+    return value;
+}
+
+} // namespace
+
+ProcessedIndex::ProcessedIndex(const QString &filePath, quint64 xorValue, bool useContentHash)
+    : m_filePath(filePath)
+    , m_xorValue(xorValue)
+    , m_useContentHash(useContentHash)
+{
+}
+
+QString ProcessedIndex::defaultFilePath(const QString &inputPath, const QString &outputPath)
+{
+    const QByteArray id = QCryptographicHash::hash(
+        (QDir(inputPath).absolutePath() + '\n' + QDir(outputPath).absolutePath()).toUtf8(),
+        QCryptographicHash::Sha1).toHex().left(16);
+
+    return QDir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation))
+        .absoluteFilePath(QString("index-%1.dat").arg(QString::fromLatin1(id)));
+}
+
+bool ProcessedIndex::stampOf(const QString &path, bool withContentHash, Stamp *stamp)
+{
+#ifdef Q_OS_UNIX
+    struct stat info;
+    if (::stat(QFile::encodeName(path).constData(), &info) != 0) {
+        return false;
+    }
+    stamp->device = info.st_dev;
+    stamp->fileId = info.st_ino;
+    stamp->size = info.st_size;
+#if defined(Q_OS_DARWIN)
+    stamp->modifiedNs = qint64(info.st_mtimespec.tv_sec) * 1000000000 + info.st_mtimespec.tv_nsec;
+#else
+    stamp->modifiedNs = qint64(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+#endif
+#else
+    QFileInfo fileInfo(path);
+    if (!fileInfo.exists()) {
+        return false;
+    }
+    stamp->device = 0;
+    stamp->fileId = 0;
+    stamp->size = fileInfo.size();
+    stamp->modifiedNs = fileInfo.lastModified().toMSecsSinceEpoch() * 1000000;
+#endif
+
+    stamp->contentHash = 0;
+    if (withContentHash) {
+        bool ok = false;
+        stamp->contentHash = hashFileContent(path, &ok);
+        if (!ok) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+QString ProcessedIndex::entryKey(const QString &path, const Stamp &stamp)
+{
+#ifdef Q_OS_UNIX
+    Q_UNUSED(path)
+    return QString("%1:%2").arg(stamp.device).arg(stamp.fileId);
+#else
+    Q_UNUSED(stamp)
+    return QFileInfo(path).absoluteFilePath();
+#endif
+}
+
+bool ProcessedIndex::load()
+{
+    QMutexLocker locker(&m_mutex);
+    m_entries.clear();
+    m_seen.clear();
+
+    QFile file(m_filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return !file.exists();
+    }
+
+    QDataStream stream(&file);
+    quint32 magic = 0;
+    quint32 version = 0;
+    quint64 xorValue = 0;
+    bool contentHashed = false;
+    qint32 count = 0;
+    stream >> magic >> version >> xorValue >> contentHashed >> count;
+
+    if (stream.status() != QDataStream::Ok || magic != INDEX_MAGIC || version != INDEX_VERSION) {
+        return false;
+    }
+
+    // Entries recorded under another key or hashing mode say nothing about this run.
+    if (xorValue != m_xorValue || contentHashed != m_useContentHash) {
+        return true;
+    }
+
+    m_entries.reserve(count);
+    for (qint32 i = 0; i < count; ++i) {
+        QString key;
+        Stamp stamp;
+        stream >> key >> stamp.device >> stamp.fileId >> stamp.size >> stamp.modifiedNs >> stamp.contentHash;
+        if (stream.status() != QDataStream::Ok) {
+            m_entries.clear();
+            return false;
+        }
+        m_entries.insert(key, stamp);
+    }
+
+    return true;
+}
+
+bool ProcessedIndex::save()
+{
+    QMutexLocker locker(&m_mutex);
+
+    QDir().mkpath(QFileInfo(m_filePath).absolutePath());
+
+    QSaveFile file(m_filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream << INDEX_MAGIC << INDEX_VERSION << m_xorValue << m_useContentHash << qint32(m_entries.size());
+
+    for (auto it = m_entries.constBegin(); it != m_entries.constEnd(); ++it) {
+        const Stamp &stamp = it.value();
+        stream << it.key() << stamp.device << stamp.fileId << stamp.size << stamp.modifiedNs << stamp.contentHash;
+    }
+
+    return stream.status() == QDataStream::Ok && file.commit();
+}
+
+bool ProcessedIndex::isUnchanged(const QString &path, Stamp *stamp)
+{
+    if (!stampOf(path, false, stamp)) {
+        return false;
+    }
+
+    const QString key = entryKey(path, *stamp);
+
+    Stamp known;
+    bool found = false;
+    {
+        QMutexLocker locker(&m_mutex);
+        m_seen.insert(key);
+
+        auto it = m_entries.constFind(key);
+        if (it != m_entries.constEnd()) {
+            known = it.value();
+            found = true;
+        }
+    }
+
+    // Size and time decide first, so an unchanged tree is not reread on every scan;
+    // the content is hashed only for files that look changed.
+    if (found && known.size == stamp->size && known.modifiedNs == stamp->modifiedNs) {
+        stamp->contentHash = known.contentHash;
+        return true;
+    }
+    if (!m_useContentHash) {
+        return false;
+    }
+
+    bool ok = false;
+    stamp->contentHash = hashFileContent(path, &ok);
+    if (!ok || !found || known.size != stamp->size || known.contentHash != stamp->contentHash) {
+        return false;
+    }
+
+    // Same bytes under a new time: record the time so the next scan skips the hash.
+    QMutexLocker locker(&m_mutex);
+    m_entries.insert(key, *stamp);
+    return true;
+}
+
+void ProcessedIndex::markProcessed(const QString &path, const Stamp &stamp)
+{
+    const QString key = entryKey(path, stamp);
+
+    QMutexLocker locker(&m_mutex);
+    m_entries.insert(key, stamp);
+    m_seen.insert(key);
+}
+
+void ProcessedIndex::pruneUnseen()
+{
+    QMutexLocker locker(&m_mutex);
+
+    for (auto it = m_entries.begin(); it != m_entries.end();) {
+        if (m_seen.contains(it.key())) {
+            ++it;
+        } else {
+            it = m_entries.erase(it);
+        }
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef PROCESSEDINDEX_H
+#define PROCESSEDINDEX_H
+
+#include <QHash>
+#include <QMutex>
+#include <QSet>
+#include <QString>
+
+class ProcessedIndex
+{
+public:
+    struct Stamp
+    {
+        quint64 device = 0;
+        quint64 fileId = 0;
+        qint64 size = -1;
+        qint64 modifiedNs = 0;
+        quint64 contentHash = 0;
+    };
+
+    ProcessedIndex(const QString &filePath, quint64 xorValue, bool useContentHash);
+
+    static QString defaultFilePath(const QString &inputPath, const QString &outputPath);
+    static bool stampOf(const QString &path, bool withContentHash, Stamp *stamp);
+
+    bool load();
+    bool save();
+
+    // True when `path` was processed before and its size and time are unchanged, or, with
+    // content hashes, its content is; `stamp` receives the current stamp either way so
+    // it can be recorded after processing.
+    bool isUnchanged(const QString &path, Stamp *stamp);
+    void markProcessed(const QString &path, const Stamp &stamp);
+    void pruneUnseen();
+
+private:
+    static QString entryKey(const QString &path, const Stamp &stamp);
+
+    QString m_filePath;
+    quint64 m_xorValue;
+    bool m_useContentHash;
+
+    mutable QMutex m_mutex;
+    QHash<QString, Stamp> m_entries;
+    QSet<QString> m_seen;
+};
+
+#endif // PROCESSEDINDEX_H
@@ -0,0 +1,205 @@
+#include "processingmetrics.h"
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QString>
+
+namespace {
+
+// Bucket upper bounds; the final +Inf bucket is implicit.
+const qint64 LATENCY_BOUNDS_NS[ProcessingMetrics::LATENCY_BUCKET_COUNT - 1] = {
+    100000LL,        // 0.1 ms
+    500000LL,
+    1000000LL,       // 1 ms
+    5000000LL,
+    10000000LL,      // 10 ms
+    50000000LL,
+    100000000LL,     // 100 ms
+    500000000LL,
+    1000000000LL,    // 1 s
+    5000000000LL,
+    10000000000LL,   // 10 s
+    60000000000LL
+};
+
+QString secondsLabel(qint64 ns)
+{
+    return ns < 0 ? QString("+Inf") : QString::number(ns / 1e9, 'g', 6);
+}
+
+} // namespace
+
+ProcessingMetrics::ProcessingMetrics()
+{
+    reset();
+}
+
+void ProcessingMetrics::reset()
+{
+    m_bytes = 0;
+    m_files = 0;
+    m_failed = 0;
+    for (std::atomic<qint64> &value : m_stageNs) {
+        value = 0;
+    }
+    for (std::atomic<qint64> &value : m_latencyBuckets) {
+        value = 0;
+    }
+    m_latencySumNs = 0;
+    m_inputQueueDepth = 0;
+    m_pipelineDepth = 0;
+    m_activeWorkers = 0;
+
+    m_lastSnapshotNs = 0;
+    m_lastSnapshotBytes = 0;
+    m_clock.start();
+}
+
+void ProcessingMetrics::recordFile(qint64 latencyNs, bool ok)
+{
+    int bucket = 0;
+    while (bucket < LATENCY_BUCKET_COUNT - 1 && latencyNs > LATENCY_BOUNDS_NS[bucket]) {
+        ++bucket;
+    }
+
+    m_latencyBuckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    m_latencySumNs.fetch_add(latencyNs, std::memory_order_relaxed);
+    (ok ? m_files : m_failed).fetch_add(1, std::memory_order_relaxed);
+}
+
+ProcessingMetrics::Snapshot ProcessingMetrics::snapshot()
+{
+    Snapshot result;
+    result.elapsedNs = m_clock.nsecsElapsed();
+    result.bytesProcessed = m_bytes.load(std::memory_order_relaxed);
+    result.filesProcessed = m_files.load(std::memory_order_relaxed);
+    result.filesFailed = m_failed.load(std::memory_order_relaxed);
+    for (int i = 0; i < StageCount; ++i) {
+        result.stageNs[i] = m_stageNs[i].load(std::memory_order_relaxed);
+    }
+    for (int i = 0; i < LATENCY_BUCKET_COUNT; ++i) {
+        result.latencyBuckets[i] = m_latencyBuckets[i].load(std::memory_order_relaxed);
+    }
+    result.latencySumNs = m_latencySumNs.load(std::memory_order_relaxed);
+    result.inputQueueDepth = m_inputQueueDepth.load(std::memory_order_relaxed);
+    result.pipelineDepth = m_pipelineDepth.load(std::memory_order_relaxed);
+    result.activeWorkers = m_activeWorkers.load(std::memory_order_relaxed);
+
+    const qint64 intervalNs = result.elapsedNs - m_lastSnapshotNs;
+    if (intervalNs > 0) {
+        result.bytesPerSecond = (result.bytesProcessed - m_lastSnapshotBytes) * 1e9 / intervalNs;
+    }
+    m_lastSnapshotNs = result.elapsedNs;
+    m_lastSnapshotBytes = result.bytesProcessed;
+
+    return result;
+}
+
+const char *ProcessingMetrics::stageName(Stage stage)
+{
+    switch (stage) {
+    case OpenStage:
+        return "open";
+    case ReadStage:
+        return "read";
+    case TransformStage:
+        return "transform";
+    case WriteStage:
+        return "write";
+    case CloseStage:
+        return "close";
+    default:
+        return "unknown";
+    }
+}
+
+qint64 ProcessingMetrics::latencyBucketBound(int index)
+{
+    return index < LATENCY_BUCKET_COUNT - 1 ? LATENCY_BOUNDS_NS[index] : -1;
+}
+
+QByteArray ProcessingMetrics::toJson(const Snapshot &snapshot)
+{
+    QJsonObject stages;
+    for (int i = 0; i < StageCount; ++i) {
+        stages[stageName(static_cast<Stage>(i))] = snapshot.stageNs[i] / 1e9;
+    }
+
+    QJsonArray buckets;
+    for (int i = 0; i < LATENCY_BUCKET_COUNT; ++i) {
+        QJsonObject bucket;
+        bucket["le"] = secondsLabel(latencyBucketBound(i));
+        bucket["count"] = snapshot.latencyBuckets[i];
+        buckets.append(bucket);
+    }
+
+    QJsonObject latency;
+    latency["buckets"] = buckets;
+    latency["sumSeconds"] = snapshot.latencySumNs / 1e9;
+
+    QJsonObject queues;
+    queues["input"] = snapshot.inputQueueDepth;
+    queues["pipeline"] = snapshot.pipelineDepth;
+    queues["activeWorkers"] = snapshot.activeWorkers;
+
+    QJsonObject root;
+    root["elapsedSeconds"] = snapshot.elapsedNs / 1e9;
+    root["bytesProcessed"] = snapshot.bytesProcessed;
+    root["bytesPerSecond"] = snapshot.bytesPerSecond;
+    root["filesProcessed"] = snapshot.filesProcessed;
+    root["filesFailed"] = snapshot.filesFailed;
+    root["stageSeconds"] = stages;
+    root["fileLatency"] = latency;
+    root["queues"] = queues;
+
+    return QJsonDocument(root).toJson(QJsonDocument::Indented);
+}
+
+QByteArray ProcessingMetrics::toPrometheus(const Snapshot &snapshot)
+{
+    QString text;
+
+    text += "# HELP fileprocessor_bytes_total Bytes transformed in the current run.\n";
+    text += "# TYPE fileprocessor_bytes_total counter\n";
+    text += QString("fileprocessor_bytes_total %1\n").arg(snapshot.bytesProcessed);
+
+    text += "# HELP fileprocessor_bytes_per_second Throughput since the previous export.\n";
+    text += "# TYPE fileprocessor_bytes_per_second gauge\n";
+    text += QString("fileprocessor_bytes_per_second %1\n").arg(snapshot.bytesPerSecond, 0, 'f', 0);
+
+    text += "# HELP fileprocessor_files_total Files finished in the current run.\n";
+    text += "# TYPE fileprocessor_files_total counter\n";
+    text += QString("fileprocessor_files_total{result=\"ok\"} %1\n").arg(snapshot.filesProcessed);
+    text += QString("fileprocessor_files_total{result=\"failed\"} %1\n").arg(snapshot.filesFailed);
+
+    text += "# HELP fileprocessor_stage_seconds_total Time spent per processing stage, summed over threads.\n";
+    text += "# TYPE fileprocessor_stage_seconds_total counter\n";
+    for (int i = 0; i < StageCount; ++i) {
+        text += QString("fileprocessor_stage_seconds_total{stage=\"%1\"} %2\n")
+                    .arg(stageName(static_cast<Stage>(i)))
+                    .arg(snapshot.stageNs[i] / 1e9, 0, 'f', 6);
+    }
+
+    text += "# HELP fileprocessor_file_latency_seconds Per-file processing latency.\n";
+    text += "# TYPE fileprocessor_file_latency_seconds histogram\n";
+    qint64 cumulative = 0;
+    for (int i = 0; i < LATENCY_BUCKET_COUNT; ++i) {
+        cumulative += snapshot.latencyBuckets[i];
+        text += QString("fileprocessor_file_latency_seconds_bucket{le=\"%1\"} %2\n")
+                    .arg(secondsLabel(latencyBucketBound(i)))
+                    .arg(cumulative);
+    }
+    text += QString("fileprocessor_file_latency_seconds_sum %1\n").arg(snapshot.latencySumNs / 1e9, 0, 'f', 6);
+    text += QString("fileprocessor_file_latency_seconds_count %1\n").arg(cumulative);
+
+    text += "# HELP fileprocessor_queue_depth Items waiting or in flight.\n";
+    text += "# TYPE fileprocessor_queue_depth gauge\n";
+    text += QString("fileprocessor_queue_depth{queue=\"input\"} %1\n").arg(snapshot.inputQueueDepth);
+    text += QString("fileprocessor_queue_depth{queue=\"pipeline\"} %1\n").arg(snapshot.pipelineDepth);
+
+    text += "# HELP fileprocessor_active_workers Workers currently processing a file.\n";
+    text += "# TYPE fileprocessor_active_workers gauge\n";
+    text += QString("fileprocessor_active_workers %1\n").arg(snapshot.activeWorkers);
+
+    return text.toUtf8();
+}
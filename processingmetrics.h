@@ -0,0 +1,108 @@
+#ifndef PROCESSINGMETRICS_H
+#define PROCESSINGMETRICS_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QMetaType>
+#include <atomic>
+
+class ProcessingMetrics
+{
+public:
+    enum Stage {
+        OpenStage,
+        ReadStage,
+        TransformStage,
+        WriteStage,
+        CloseStage,
+        StageCount
+    };
+
+    static constexpr int LATENCY_BUCKET_COUNT = 13;
+
+    struct Snapshot
+    {
+        qint64 elapsedNs = 0;
+        qint64 bytesProcessed = 0;
+        qint64 filesProcessed = 0;
+        qint64 filesFailed = 0;
+        double bytesPerSecond = 0.0;
+        qint64 stageNs[StageCount] = {};
+        // Per-bucket (non-cumulative) counts; the last bucket is +Inf.
+        qint64 latencyBuckets[LATENCY_BUCKET_COUNT] = {};
+        qint64 latencySumNs = 0;
+        int inputQueueDepth = 0;
+        int pipelineDepth = 0;
+        int activeWorkers = 0;
+    };
+
+    ProcessingMetrics();
+
+    ProcessingMetrics(const ProcessingMetrics &) = delete;
+    ProcessingMetrics &operator=(const ProcessingMetrics &) = delete;
+
+    void reset();
+
+    void addBytes(qint64 bytes) { m_bytes.fetch_add(bytes, std::memory_order_relaxed); }
+    void addStageTime(Stage stage, qint64 ns) { m_stageNs[stage].fetch_add(ns, std::memory_order_relaxed); }
+    void adjustPipelineDepth(int delta) { m_pipelineDepth.fetch_add(delta, std::memory_order_relaxed); }
+    void adjustActiveWorkers(int delta) { m_activeWorkers.fetch_add(delta, std::memory_order_relaxed); }
+    void setInputQueueDepth(int depth) { m_inputQueueDepth.store(depth, std::memory_order_relaxed); }
+    void recordFile(qint64 latencyNs, bool ok);
+
+    // Not thread-safe with respect to itself: the rate is computed against the previous call.
+    Snapshot snapshot();
+
+    static const char *stageName(Stage stage);
+    // Upper bound of a latency bucket in nanoseconds, -1 for the +Inf bucket.
+    static qint64 latencyBucketBound(int index);
+
+    static QByteArray toJson(const Snapshot &snapshot);
+    static QByteArray toPrometheus(const Snapshot &snapshot);
+
+private:
+    QElapsedTimer m_clock;
+    std::atomic<qint64> m_bytes;
+    std::atomic<qint64> m_files;
+    std::atomic<qint64> m_failed;
+    std::atomic<qint64> m_stageNs[StageCount];
+    std::atomic<qint64> m_latencyBuckets[LATENCY_BUCKET_COUNT];
+    std::atomic<qint64> m_latencySumNs;
+    std::atomic<int> m_inputQueueDepth;
+    std::atomic<int> m_pipelineDepth;
+    std::atomic<int> m_activeWorkers;
+
+    qint64 m_lastSnapshotNs;
+    qint64 m_lastSnapshotBytes;
+};
+
+// Attributes the time since the previous lap (or construction/reset) to a stage.
+class StageClock
+{
+public:
+    explicit StageClock(ProcessingMetrics &metrics)
+        : m_metrics(metrics)
+        , m_last(0)
+    {
+        m_timer.start();
+    }
+
+    void lap(ProcessingMetrics::Stage stage)
+    {
+        const qint64 now = m_timer.nsecsElapsed();
+        m_metrics.addStageTime(stage, now - m_last);
+        m_last = now;
+    }
+
+    // Drops the time since the previous lap, e.g. time spent blocked on a queue.
+    void reset() { m_last = m_timer.nsecsElapsed(); }
+
+private:
+    ProcessingMetrics &m_metrics;
+    QElapsedTimer m_timer;
+    qint64 m_last;
+};
+
+Q_DECLARE_METATYPE(ProcessingMetrics::Snapshot)
+
+#endif // PROCESSINGMETRICS_H
@@ -0,0 +1,157 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <cstdio>
+#include "packarchive.h"
+
+namespace {
+
+void printEvent(const QJsonObject &event, FILE *stream = stdout)
+{
+    const QByteArray line = QJsonDocument(event).toJson(QJsonDocument::Compact);
+    std::fwrite(line.constData(), 1, line.size(), stream);
+    std::fputc('\n', stream);
+    std::fflush(stream);
+}
+
+// Entry names are relative paths; anything that would land outside the target is refused.
+QString targetPathFor(const QDir &outputDir, const QString &name)
+{
+    const QString cleanName = QDir::cleanPath(name);
+    if (cleanName.isEmpty() || QDir::isAbsolutePath(cleanName) || cleanName == ".." || cleanName.startsWith("../")) {
+        return QString();
+    }
+    return outputDir.absoluteFilePath(cleanName);
+}
+
+bool restoreEntry(const PackReader &reader, const PackReader::Entry &entry, const QDir &outputDir, QString *error)
+{
+    const QString targetPath = targetPathFor(outputDir, entry.name);
+    if (targetPath.isEmpty()) {
+        *error = "Недопустимое имя записи: " + entry.name;
+        return false;
+    }
+
+    QDir().mkpath(QFileInfo(targetPath).absolutePath());
+
+    QSaveFile file(targetPath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        *error = "Не удалось создать файл: " + targetPath;
+        return false;
+    }
+    if (!reader.read(entry, &file, error)) {
+        file.cancelWriting();
+        return false;
+    }
+    if (!file.commit()) {
+        *error = "Не удалось сохранить файл: " + targetPath;
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    app.setApplicationName("fileprocessor_unpack");
+    app.setApplicationVersion("1.0");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Restores files from packed XOR processor output");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addPositionalArgument("pack", "Directory with pack segments, or a single segment file.");
+    parser.addOptions({
+        { "list", "List the entries instead of extracting them." },
+        { "entry", "Extract only this entry; written to stdout unless --output is given.", "name" },
+        { "output", "Directory to restore the files into.", "path" },
+    });
+    parser.process(app);
+
+    const QStringList arguments = parser.positionalArguments();
+    if (arguments.size() != 1) {
+        parser.showHelp(2);
+    }
+
+    PackReader reader(arguments.first());
+    QString error;
+    if (!reader.load(&error)) {
+        printEvent({ { "event", "error" }, { "message", error } }, stderr);
+        return 2;
+    }
+
+    if (parser.isSet("list")) {
+        for (const PackReader::Entry &entry : reader.entries()) {
+            printEvent({ { "event", "entry" },
+                         { "name", entry.name },
+                         { "size", entry.size },
+                         { "segment", QFileInfo(entry.segmentPath).fileName() },
+                         { "offset", entry.offset } });
+        }
+        return 0;
+    }
+
+    const QString outputPath = parser.value("output");
+
+    // A single entry is a seek and one contiguous read through the index.
+    if (parser.isSet("entry")) {
+        PackReader::Entry entry;
+        if (!reader.find(parser.value("entry"), &entry)) {
+            printEvent({ { "event", "error" }, { "message", "Запись не найдена: " + parser.value("entry") } }, stderr);
+            return 1;
+        }
+
+        bool ok;
+        if (outputPath.isEmpty()) {
+            QFile output;
+            ok = output.open(stdout, QIODevice::WriteOnly) && reader.read(entry, &output, &error);
+        } else {
+            ok = restoreEntry(reader, entry, QDir(outputPath), &error);
+        }
+        if (!ok) {
+            printEvent({ { "event", "error" }, { "message", error } }, stderr);
+            return 1;
+        }
+        return 0;
+    }
+
+    if (outputPath.isEmpty()) {
+        printEvent({ { "event", "error" }, { "message", "Укажите папку для извлечения (--output)" } }, stderr);
+        return 2;
+    }
+
+    const QDir outputDir(outputPath);
+    if (!outputDir.exists() && !QDir().mkpath(outputPath)) {
+        printEvent({ { "event", "error" }, { "message", "Не удалось создать папку: " + outputPath } }, stderr);
+        return 2;
+    }
+
+    int restoredCount = 0;
+    int failedCount = 0;
+    qint64 restoredBytes = 0;
+    const QVector<PackReader::Entry> entries = reader.latestEntries();
+    for (const PackReader::Entry &entry : entries) {
+        if (restoreEntry(reader, entry, outputDir, &error)) {
+            ++restoredCount;
+            restoredBytes += entry.size;
+        } else {
+            ++failedCount;
+            printEvent({ { "event", "error" }, { "message", error } }, stderr);
+        }
+    }
+
+    printEvent({ { "event", "summary" },
+                 { "restored", restoredCount },
+                 { "failed", failedCount },
+                 { "bytes", restoredBytes } });
+
+    return failedCount > 0 ? 1 : 0;
+}
@@ -0,0 +1,358 @@
+#include "uringengine.h"
+
+#ifdef HAVE_LIBURING
+
+#include "bufferpool.h"
+#include "xorkernel.h"
+#include <QFile>
+#include <liburing.h>
+#include <fcntl.h>
+#include <cerrno>
+#include <sys/uio.h>
+
+namespace {
+
+enum Operation {
+    OpenInput,
+    OpenOutput,
+    Read,
+    Write,
+    CloseInput,
+    CloseOutput
+};
+
+quint64 encodeUserData(int slot, Operation operation)
+{
+    return (static_cast<quint64>(slot) << 8) | operation;
+}
+
+} // namespace
+
+// Each slot drives one file at a time through open -> (read -> XOR -> write)* -> close.
+// Slot s owns registered buffer s and fixed-file indices 2s (input) and 2s + 1 (output).
+struct UringEngine::Private
+{
+    struct Slot
+    {
+        int job = -1;
+        int pending = 0;
+        bool inputOpen = false;
+        bool outputOpen = false;
+        bool failed = false;
+        qint64 offset = 0;
+        qint64 length = 0;
+        qint64 written = 0;
+        QByteArray inputName;
+        QByteArray outputName;
+    };
+
+    io_uring ring;
+    bool ringReady = false;
+    bool valid = false;
+    int slotCount = 0;
+    qint64 bufferSize = 0;
+    XorKey key;
+    QVector<char *> buffers;
+    QVector<Slot> states;
+
+    io_uring_sqe *sqe(int slot, Operation operation)
+    {
+        io_uring_sqe *entry = io_uring_get_sqe(&ring);
+        if (!entry) {
+            io_uring_submit(&ring);
+            entry = io_uring_get_sqe(&ring);
+        }
+        io_uring_sqe_set_data64(entry, encodeUserData(slot, operation));
+        return entry;
+    }
+
+    void submitOpen(int slot)
+    {
+        Slot &s = states[slot];
+        s.pending = 2;
+
+        io_uring_prep_openat_direct(sqe(slot, OpenInput), AT_FDCWD, s.inputName.constData(),
+                                    O_RDONLY | O_CLOEXEC, 0, 2 * slot);
+        io_uring_prep_openat_direct(sqe(slot, OpenOutput), AT_FDCWD, s.outputName.constData(),
+                                    O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666, 2 * slot + 1);
+    }
+
+    void submitRead(int slot)
+    {
+        Slot &s = states[slot];
+        io_uring_sqe *entry = sqe(slot, Read);
+        io_uring_prep_read_fixed(entry, 2 * slot, buffers[slot], bufferSize, s.offset, slot);
+        entry->flags |= IOSQE_FIXED_FILE;
+    }
+
+    void submitWrite(int slot)
+    {
+        Slot &s = states[slot];
+        io_uring_sqe *entry = sqe(slot, Write);
+        io_uring_prep_write_fixed(entry, 2 * slot + 1, buffers[slot] + s.written, s.length - s.written,
+                                  s.offset + s.written, slot);
+        entry->flags |= IOSQE_FIXED_FILE;
+    }
+
+    int runOne(io_uring_sqe *entry)
+    {
+        io_uring_sqe_set_data64(entry, 0);
+        if (io_uring_submit(&ring) < 0) {
+            return -1;
+        }
+        io_uring_cqe *cqe = nullptr;
+        if (io_uring_wait_cqe(&ring, &cqe) < 0) {
+            return -1;
+        }
+        const int result = cqe->res;
+        io_uring_cqe_seen(&ring, cqe);
+        return result;
+    }
+
+    // Opening straight into the fixed-file table needs Linux 5.15. Older kernels have
+    // the opcodes but reject the table index with -EINVAL, so only a real open tells.
+    bool directOpenWorks()
+    {
+        io_uring_sqe *entry = io_uring_get_sqe(&ring);
+        io_uring_prep_openat_direct(entry, AT_FDCWD, "/", O_RDONLY | O_DIRECTORY | O_CLOEXEC, 0, 0);
+        if (runOne(entry) < 0) {
+            return false;
+        }
+
+        entry = io_uring_get_sqe(&ring);
+        io_uring_prep_close_direct(entry, 0);
+        return runOne(entry) >= 0;
+    }
+
+    void submitClose(int slot)
+    {
+        Slot &s = states[slot];
+        s.pending = 0;
+
+        if (s.inputOpen) {
+            io_uring_prep_close_direct(sqe(slot, CloseInput), 2 * slot);
+            ++s.pending;
+        }
+        if (s.outputOpen) {
+            io_uring_prep_close_direct(sqe(slot, CloseOutput), 2 * slot + 1);
+            ++s.pending;
+        }
+    }
+};
+
+UringEngine::UringEngine(int queueDepth, qint64 bufferSize, const XorKey &key)
+    : d(new Private)
+{
+    d->slotCount = qMax(1, queueDepth);
+    d->bufferSize = bufferSize;
+    d->key = key;
+    d->states.resize(d->slotCount);
+
+    if (io_uring_queue_init(4 * d->slotCount, &d->ring, 0) < 0) {
+        return;
+    }
+    d->ringReady = true;
+
+    QVector<iovec> iovecs;
+    for (int i = 0; i < d->slotCount; ++i) {
+        char *buffer = BufferPool::allocateAligned(bufferSize);
+        d->buffers.append(buffer);
+        iovecs.append({ buffer, static_cast<size_t>(bufferSize) });
+    }
+
+    if (io_uring_register_buffers(&d->ring, iovecs.constData(), iovecs.size()) < 0) {
+        return;
+    }
+    if (io_uring_register_files_sparse(&d->ring, 2 * d->slotCount) < 0) {
+        return;
+    }
+    if (!d->directOpenWorks()) {
+        return;
+    }
+
+    d->valid = true;
+}
+
+UringEngine::~UringEngine()
+{
+    if (d->ringReady) {
+        io_uring_queue_exit(&d->ring);
+    }
+    for (char *buffer : d->buffers) {
+        BufferPool::freeAligned(buffer);
+    }
+    delete d;
+}
+
+bool UringEngine::isSupported()
+{
+    io_uring_probe *probe = io_uring_get_probe();
+    if (!probe) {
+        return false;
+    }
+
+    const bool supported = io_uring_opcode_supported(probe, IORING_OP_OPENAT)
+        && io_uring_opcode_supported(probe, IORING_OP_CLOSE)
+        && io_uring_opcode_supported(probe, IORING_OP_READ_FIXED)
+        && io_uring_opcode_supported(probe, IORING_OP_WRITE_FIXED);
+    io_uring_free_probe(probe);
+
+    return supported;
+}
+
+bool UringEngine::isValid() const
+{
+    return d->valid;
+}
+
+void UringEngine::process(QVector<Job> &jobs, const std::atomic<bool> &stopRequested)
+{
+    int nextJob = 0;
+    int active = 0;
+
+    auto startJob = [&](int slot) {
+        if (nextJob >= jobs.size()) {
+            d->states[slot].job = -1;
+            return;
+        }
+
+        Private::Slot &s = d->states[slot];
+        s = Private::Slot();
+        s.job = nextJob++;
+        s.inputName = QFile::encodeName(jobs[s.job].inputPath);
+        s.outputName = QFile::encodeName(jobs[s.job].outputPath);
+        ++active;
+
+        d->submitOpen(slot);
+    };
+
+    auto finishJob = [&](int slot) {
+        Private::Slot &s = d->states[slot];
+        jobs[s.job].ok = !s.failed;
+        --active;
+        startJob(slot);
+    };
+
+    auto closeSlot = [&](int slot) {
+        d->submitClose(slot);
+        if (d->states[slot].pending == 0) {
+            finishJob(slot);
+        }
+    };
+
+    for (int slot = 0; slot < d->slotCount; ++slot) {
+        startJob(slot);
+    }
+
+    while (active > 0) {
+        io_uring_submit(&d->ring);
+
+        io_uring_cqe *cqe = nullptr;
+        int ret = io_uring_wait_cqe(&d->ring, &cqe);
+        if (ret == -EINTR) {
+            continue;
+        }
+        if (ret < 0) {
+            return;
+        }
+
+        do {
+            const quint64 userData = io_uring_cqe_get_data64(cqe);
+            const int result = cqe->res;
+            io_uring_cqe_seen(&d->ring, cqe);
+
+            const int slot = static_cast<int>(userData >> 8);
+            const Operation operation = static_cast<Operation>(userData & 0xff);
+            Private::Slot &s = d->states[slot];
+
+            switch (operation) {
+            case OpenInput:
+            case OpenOutput:
+                if (result < 0) {
+                    s.failed = true;
+                } else if (operation == OpenInput) {
+                    s.inputOpen = true;
+                } else {
+                    s.outputOpen = true;
+                }
+                if (--s.pending == 0) {
+                    if (s.failed) {
+                        closeSlot(slot);
+                    } else {
+                        d->submitRead(slot);
+                    }
+                }
+                break;
+
+            case Read:
+                if (result <= 0) {
+                    s.failed = s.failed || result < 0;
+                    closeSlot(slot);
+                } else {
+                    XorKernel::apply(d->buffers[slot], d->buffers[slot], result, d->key, s.offset);
+                    s.length = result;
+                    s.written = 0;
+                    d->submitWrite(slot);
+                }
+                break;
+
+            case Write:
+                if (result <= 0) {
+                    s.failed = true;
+                    closeSlot(slot);
+                } else if ((s.written += result) < s.length) {
+                    d->submitWrite(slot);
+                } else if (stopRequested) {
+                    s.failed = true;
+                    closeSlot(slot);
+                } else {
+                    s.offset += s.length;
+                    d->submitRead(slot);
+                }
+                break;
+
+            case CloseInput:
+            case CloseOutput:
+                // A failed close of the output can mean its last writes never made it.
+                if (operation == CloseOutput && result < 0) {
+                    s.failed = true;
+                }
+                if (--s.pending == 0) {
+                    finishJob(slot);
+                }
+                break;
+            }
+        } while (io_uring_peek_cqe(&d->ring, &cqe) == 0);
+    }
+}
+
+#else
+
+struct UringEngine::Private
+{
+};
+
+UringEngine::UringEngine(int, qint64, const XorKey &)
+    : d(nullptr)
+{
+}
+
+UringEngine::~UringEngine()
+{
+}
+
+bool UringEngine::isSupported()
+{
+    return false;
+}
+
+bool UringEngine::isValid() const
+{
+    return false;
+}
+
+void UringEngine::process(QVector<Job> &, const std::atomic<bool> &)
+{
+}
+
+#endif // HAVE_LIBURING
@@ -0,0 +1,35 @@
+#ifndef URINGENGINE_H
+#define URINGENGINE_H
+
+#include <QString>
+#include <QVector>
+#include <atomic>
+#include "xorkey.h"
+
+class UringEngine
+{
+public:
+    struct Job
+    {
+        QString inputPath;
+        QString outputPath;
+        bool ok = false;
+    };
+
+    UringEngine(int queueDepth, qint64 bufferSize, const XorKey &key);
+    ~UringEngine();
+
+    UringEngine(const UringEngine &) = delete;
+    UringEngine &operator=(const UringEngine &) = delete;
+
+    static bool isSupported();
+
+    bool isValid() const;
+    void process(QVector<Job> &jobs, const std::atomic<bool> &stopRequested);
+
+private:
+    struct Private;
+    Private *d;
+};
+
+#endif // URINGENGINE_H
@@ -0,0 +1,379 @@
+#include "xorkernel.h"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define XORKERNEL_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define XORKERNEL_TARGET(isa) __attribute__((target(isa)))
+#else
+#define XORKERNEL_TARGET(isa)
+#endif
+
+namespace {
+
+inline qint64 wrapPhase(qint64 phase, qint64 period)
+{
+    return phase >= period ? phase - period : phase;
+}
+
+// Position in the keystream. For a uniform key every keystream byte is the same, so
+// the phase never has to be tracked and the SIMD kernels hoist one broadcast register.
+template <bool Uniform>
+class KeyCursor
+{
+public:
+    KeyCursor(const char *keystream, qint64 period, qint64 offset)
+        : m_keystream(keystream)
+        , m_period(period)
+        , m_phase(Uniform ? 0 : offset % period)
+    {
+    }
+
+    // Key bytes for the next `length` (at most XorKey::PADDING) stream bytes.
+    const char *next(qint64 length)
+    {
+        const char *key = m_keystream + m_phase;
+        if (!Uniform) {
+            m_phase = wrapPhase(m_phase + length, m_period);
+        }
+        return key;
+    }
+
+    char byte() const { return m_keystream[0]; }
+
+private:
+    const char *m_keystream;
+    qint64 m_period;
+    qint64 m_phase;
+};
+
+template <bool Uniform>
+inline void xorBytes(const char *src, char *dst, qint64 size, KeyCursor<Uniform> &key)
+{
+    if (Uniform) {
+        const char byte = key.byte();
+        for (qint64 i = 0; i < size; ++i) {
+            dst[i] = src[i] ^ byte;
+        }
+    } else {
+        for (qint64 i = 0; i < size; ++i) {
+            dst[i] = src[i] ^ *key.next(1);
+        }
+    }
+}
+
+// Scalar bytes up to the first `alignment`-aligned dst address; returns how many were consumed.
+template <bool Uniform>
+inline qint64 alignHead(const char *src, char *dst, qint64 size, KeyCursor<Uniform> &key, quintptr alignment)
+{
+    qint64 head = (alignment - (reinterpret_cast<quintptr>(dst) & (alignment - 1))) & (alignment - 1);
+    if (head > size) {
+        head = size;
+    }
+    xorBytes(src, dst, head, key);
+    return head;
+}
+
+// The keystream period is a multiple of every vector width and at least a few KiB, and
+// XorKey::PADDING covers the widest unrolled step, so each step below reads its key
+// bytes with plain loads and wraps the phase at most once.
+
+void copyBytes(const char *src, char *dst, qint64 size, const char *, qint64, qint64)
+{
+    if (src != dst && size > 0) {
+        std::memmove(dst, src, size);
+    }
+}
+
+template <bool Uniform>
+void xorScalar(const char *src, char *dst, qint64 size, const char *keystream, qint64 period, qint64 offset)
+{
+    KeyCursor<Uniform> key(keystream, period, offset);
+    xorBytes(src, dst, size, key);
+}
+
+template <bool Uniform>
+void xorWord64(const char *src, char *dst, qint64 size, const char *keystream, qint64 period, qint64 offset)
+{
+    KeyCursor<Uniform> key(keystream, period, offset);
+    qint64 i = alignHead(src, dst, size, key, 8);
+
+    quint64 broadcast;
+    std::memcpy(&broadcast, keystream, 8);
+
+    for (; i + 8 <= size; i += 8) {
+        quint64 value;
+        quint64 word = broadcast;
+        std::memcpy(&value, src + i, 8);
+        if (!Uniform) {
+            std::memcpy(&word, key.next(8), 8);
+        }
+        value ^= word;
+        std::memcpy(dst + i, &value, 8);
+    }
+
+    xorBytes(src + i, dst + i, size - i, key);
+}
+
+#ifdef XORKERNEL_X86
+
+// Key vector at `k`, or the hoisted broadcast register for a uniform key.
+template <bool Uniform>
+XORKERNEL_TARGET("sse2")
+inline __m128i keyVector(__m128i broadcast, const char *k)
+{
+    return Uniform ? broadcast : _mm_loadu_si128(reinterpret_cast<const __m128i *>(k));
+}
+
+template <bool Uniform>
+XORKERNEL_TARGET("avx2")
+inline __m256i keyVector(__m256i broadcast, const char *k)
+{
+    return Uniform ? broadcast : _mm256_loadu_si256(reinterpret_cast<const __m256i *>(k));
+}
+
+template <bool Uniform>
+XORKERNEL_TARGET("avx512f")
+inline __m512i keyVector(__m512i broadcast, const char *k)
+{
+    return Uniform ? broadcast : _mm512_loadu_si512(k);
+}
+
+template <bool Uniform>
+XORKERNEL_TARGET("sse2")
+void xorSse2(const char *src, char *dst, qint64 size, const char *keystream, qint64 period, qint64 offset)
+{
+    KeyCursor<Uniform> key(keystream, period, offset);
+    qint64 i = alignHead(src, dst, size, key, 16);
+
+    const __m128i broadcast = _mm_set1_epi8(keystream[0]);
+
+    for (; i + 64 <= size; i += 64) {
+        const char *k = key.next(64);
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i + 16));
+        __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i + 32));
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i + 48));
+        a = _mm_xor_si128(a, keyVector<Uniform>(broadcast, k));
+        b = _mm_xor_si128(b, keyVector<Uniform>(broadcast, k + 16));
+        c = _mm_xor_si128(c, keyVector<Uniform>(broadcast, k + 32));
+        d = _mm_xor_si128(d, keyVector<Uniform>(broadcast, k + 48));
+        _mm_store_si128(reinterpret_cast<__m128i *>(dst + i), a);
+        _mm_store_si128(reinterpret_cast<__m128i *>(dst + i + 16), b);
+        _mm_store_si128(reinterpret_cast<__m128i *>(dst + i + 32), c);
+        _mm_store_si128(reinterpret_cast<__m128i *>(dst + i + 48), d);
+    }
+    for (; i + 16 <= size; i += 16) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        a = _mm_xor_si128(a, keyVector<Uniform>(broadcast, key.next(16)));
+        _mm_store_si128(reinterpret_cast<__m128i *>(dst + i), a);
+    }
+
+    xorBytes(src + i, dst + i, size - i, key);
+}
+
+template <bool Uniform>
+XORKERNEL_TARGET("avx2")
+void xorAvx2(const char *src, char *dst, qint64 size, const char *keystream, qint64 period, qint64 offset)
+{
+    KeyCursor<Uniform> key(keystream, period, offset);
+    qint64 i = alignHead(src, dst, size, key, 32);
+
+    const __m256i broadcast = _mm256_set1_epi8(keystream[0]);
+
+    for (; i + 128 <= size; i += 128) {
+        const char *k = key.next(128);
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i + 32));
+        __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i + 64));
+        __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i + 96));
+        a = _mm256_xor_si256(a, keyVector<Uniform>(broadcast, k));
+        b = _mm256_xor_si256(b, keyVector<Uniform>(broadcast, k + 32));
+        c = _mm256_xor_si256(c, keyVector<Uniform>(broadcast, k + 64));
+        d = _mm256_xor_si256(d, keyVector<Uniform>(broadcast, k + 96));
+        _mm256_store_si256(reinterpret_cast<__m256i *>(dst + i), a);
+        _mm256_store_si256(reinterpret_cast<__m256i *>(dst + i + 32), b);
+        _mm256_store_si256(reinterpret_cast<__m256i *>(dst + i + 64), c);
+        _mm256_store_si256(reinterpret_cast<__m256i *>(dst + i + 96), d);
+    }
+    for (; i + 32 <= size; i += 32) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+        a = _mm256_xor_si256(a, keyVector<Uniform>(broadcast, key.next(32)));
+        _mm256_store_si256(reinterpret_cast<__m256i *>(dst + i), a);
+    }
+    _mm256_zeroupper();
+
+    xorBytes(src + i, dst + i, size - i, key);
+}
+
+template <bool Uniform>
+XORKERNEL_TARGET("avx512f")
+void xorAvx512(const char *src, char *dst, qint64 size, const char *keystream, qint64 period, qint64 offset)
+{
+    KeyCursor<Uniform> key(keystream, period, offset);
+    qint64 i = alignHead(src, dst, size, key, 64);
+
+    // avx512f has no byte broadcast; the keystream already holds 64 copies of the byte.
+    const __m512i broadcast = _mm512_loadu_si512(keystream);
+
+    for (; i + 256 <= size; i += 256) {
+        const char *k = key.next(256);
+        __m512i a = _mm512_loadu_si512(src + i);
+        __m512i b = _mm512_loadu_si512(src + i + 64);
+        __m512i c = _mm512_loadu_si512(src + i + 128);
+        __m512i d = _mm512_loadu_si512(src + i + 192);
+        a = _mm512_xor_si512(a, keyVector<Uniform>(broadcast, k));
+        b = _mm512_xor_si512(b, keyVector<Uniform>(broadcast, k + 64));
+        c = _mm512_xor_si512(c, keyVector<Uniform>(broadcast, k + 128));
+        d = _mm512_xor_si512(d, keyVector<Uniform>(broadcast, k + 192));
+        _mm512_store_si512(dst + i, a);
+        _mm512_store_si512(dst + i + 64, b);
+        _mm512_store_si512(dst + i + 128, c);
+        _mm512_store_si512(dst + i + 192, d);
+    }
+    for (; i + 64 <= size; i += 64) {
+        __m512i a = _mm512_loadu_si512(src + i);
+        a = _mm512_xor_si512(a, keyVector<Uniform>(broadcast, key.next(64)));
+        _mm512_store_si512(dst + i, a);
+    }
+    _mm256_zeroupper();
+
+    xorBytes(src + i, dst + i, size - i, key);
+}
+
+bool cpuSupports(XorKernel::Variant variant)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_cpu_init();
+    switch (variant) {
+    case XorKernel::Sse2:
+        return __builtin_cpu_supports("sse2");
+    case XorKernel::Avx2:
+        return __builtin_cpu_supports("avx2");
+    case XorKernel::Avx512:
+        return __builtin_cpu_supports("avx512f");
+    default:
+        return true;
+    }
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    const int maxLeaf = info[0];
+
+    __cpuid(info, 1);
+    const bool sse2 = (info[3] & (1 << 26)) != 0;
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+
+    bool avx2 = false;
+    bool avx512 = false;
+    if (maxLeaf >= 7) {
+        __cpuidex(info, 7, 0);
+        avx2 = (info[1] & (1 << 5)) != 0 && (xcr0 & 0x6) == 0x6;
+        avx512 = (info[1] & (1 << 16)) != 0 && (xcr0 & 0xe6) == 0xe6;
+    }
+
+    switch (variant) {
+    case XorKernel::Sse2:
+        return sse2;
+    case XorKernel::Avx2:
+        return avx2;
+    case XorKernel::Avx512:
+        return avx512;
+    default:
+        return true;
+    }
+#else
+    return variant == XorKernel::Scalar || variant == XorKernel::Word64;
+#endif
+}
+
+#else
+
+bool cpuSupports(XorKernel::Variant variant)
+{
+    return variant == XorKernel::Scalar || variant == XorKernel::Word64;
+}
+
+#endif // XORKERNEL_X86
+
+} // namespace
+
+XorKernel::Function XorKernel::s_best[] = {
+    XorKernel::function(XorKernel::bestVariant(), XorKey::GeneralKey),
+    XorKernel::function(XorKernel::bestVariant(), XorKey::UniformKey),
+    XorKernel::function(XorKernel::bestVariant(), XorKey::IdentityKey),
+};
+
+XorKernel::Variant XorKernel::bestVariant()
+{
+    static const Variant best = [] {
+        const Variant candidates[] = { Avx512, Avx2, Sse2 };
+        for (Variant variant : candidates) {
+            if (isSupported(variant)) {
+                return variant;
+            }
+        }
+        return Word64;
+    }();
+
+    return best;
+}
+
+bool XorKernel::isSupported(Variant variant)
+{
+    return cpuSupports(variant);
+}
+
+XorKernel::Function XorKernel::function(Variant variant, XorKey::Kind kind)
+{
+    if (kind == XorKey::IdentityKey) {
+        return isSupported(variant) ? copyBytes : nullptr;
+    }
+
+    const bool uniform = kind == XorKey::UniformKey;
+    switch (variant) {
+    case Scalar:
+        return uniform ? xorScalar<true> : xorScalar<false>;
+    case Word64:
+        return uniform ? xorWord64<true> : xorWord64<false>;
+#ifdef XORKERNEL_X86
+    case Sse2:
+        return uniform ? xorSse2<true> : xorSse2<false>;
+    case Avx2:
+        return uniform ? xorAvx2<true> : xorAvx2<false>;
+    case Avx512:
+        return uniform ? xorAvx512<true> : xorAvx512<false>;
+#endif
+    default:
+        return nullptr;
+    }
+}
+
+const char *XorKernel::variantName(Variant variant)
+{
+    switch (variant) {
+    case Scalar:
+        return "scalar";
+    case Word64:
+        return "word64";
+    case Sse2:
+        return "sse2";
+    case Avx2:
+        return "avx2";
+    case Avx512:
+        return "avx512";
+    }
+    return "unknown";
+}
+
+void XorKernel::apply(const char *src, char *dst, qint64 size, const XorKey &key, qint64 offset)
+{
+    s_best[key.kind()](src, dst, size, key.keystream(), key.period(), offset);
+}
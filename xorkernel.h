@@ -0,0 +1,36 @@
+#ifndef XORKERNEL_H
+#define XORKERNEL_H
+
+#include <QtGlobal>
+#include "xorkey.h"
+
+class XorKernel
+{
+public:
+    enum Variant {
+        Scalar,
+        Word64,
+        Sse2,
+        Avx2,
+        Avx512
+    };
+
+    // dst[i] = src[i] ^ keystream[(offset + i) % period]; src and dst may be the same buffer.
+    // keystream must be laid out as by XorKey.
+    typedef void (*Function)(const char *src, char *dst, qint64 size, const char *keystream, qint64 period,
+                             qint64 offset);
+
+    static Variant bestVariant();
+    static bool isSupported(Variant variant);
+    // Kernel specialised for the key's kind: uniform keys get a broadcast variant of
+    // each kernel, identity keys a plain copy.
+    static Function function(Variant variant, XorKey::Kind kind = XorKey::GeneralKey);
+    static const char *variantName(Variant variant);
+
+    static void apply(const char *src, char *dst, qint64 size, const XorKey &key, qint64 offset);
+
+private:
+    static Function s_best[3];
+};
+
+#endif // XORKERNEL_H
@@ -0,0 +1,152 @@
+#include <QByteArray>
+#include <QRandomGenerator>
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+#include "xorkernel.h"
+
+// Every supported kernel variant, specialised for every key kind, must produce the
+// scalar kernel's output byte for byte: misaligned buffers, sizes around the vector
+// widths, arbitrary keystream offsets and key lengths that do and don't divide them.
+namespace {
+
+const int KEY_LENGTHS[] = { 1, 8, 37, 64, 4097 };
+const int ROUNDS_PER_CASE = 200;
+const qint64 MAX_SIZE = 3 * 4096 + 129;
+const int MAX_MISALIGNMENT = 64;
+
+QByteArray randomBytes(QRandomGenerator &random, qint64 size)
+{
+    QByteArray bytes(size, Qt::Uninitialized);
+    for (char &byte : bytes) {
+        byte = char(random.bounded(256));
+    }
+    return bytes;
+}
+
+XorKey makeKey(QRandomGenerator &random, int length, XorKey::Kind kind)
+{
+    switch (kind) {
+    case XorKey::IdentityKey:
+        return XorKey(QByteArray(length, '\0'));
+    case XorKey::UniformKey:
+        return XorKey(QByteArray(length, char(1 + random.bounded(255))));
+    default: {
+        // Two differing bytes, so the key can't turn out uniform by chance.
+        QByteArray bytes = randomBytes(random, length);
+        if (length > 1) {
+            bytes[0] = 0x11;
+            bytes[1] = 0x22;
+        }
+        return XorKey(bytes);
+    }
+    }
+}
+
+qint64 randomSize(QRandomGenerator &random)
+{
+    // Half the cases stay below a few vectors, where head and tail handling dominate.
+    return random.bounded(2) ? random.bounded(qint64(257)) : random.bounded(MAX_SIZE + 1);
+}
+
+bool checkCase(QRandomGenerator &random, XorKernel::Variant variant, const XorKey &key)
+{
+    const XorKernel::Function kernel = XorKernel::function(variant, key.kind());
+    const XorKernel::Function reference = XorKernel::function(XorKernel::Scalar, XorKey::GeneralKey);
+
+    for (int round = 0; round < ROUNDS_PER_CASE; ++round) {
+        const qint64 size = randomSize(random);
+        const qint64 offset = random.bounded(qint64(1) << 40);
+        const int srcShift = random.bounded(MAX_MISALIGNMENT);
+        const int dstShift = random.bounded(MAX_MISALIGNMENT);
+        const bool inPlace = random.bounded(4) == 0;
+
+        const QByteArray input = randomBytes(random, size);
+        std::vector<char> expected(size + 1);
+        reference(input.constData(), expected.data(), size, key.keystream(), key.period(), offset);
+
+        // The scalar kernel itself against the definition: data ^ key[(offset + i) % length].
+        if (variant == XorKernel::Scalar && key.kind() == XorKey::GeneralKey) {
+            for (qint64 i = 0; i < size; ++i) {
+                const char keyByte = key.bytes().at(int((offset + i) % key.size()));
+                if (expected[i] != char(input.at(i) ^ keyByte)) {
+                    std::fprintf(stderr, "scalar reference wrong: key %d bytes, offset %lld, byte %lld\n",
+                                 key.size(), offset, i);
+                    return false;
+                }
+            }
+        }
+
+        // Guard bytes around the output catch kernels that write past either end.
+        const char guard = char(0xa5);
+        std::vector<char> buffer(size + 2 * MAX_MISALIGNMENT + 2, guard);
+        char *dst = buffer.data() + 1 + dstShift;
+        std::vector<char> source(size + MAX_MISALIGNMENT + 1);
+        const char *src = source.data() + srcShift;
+        std::copy(input.constBegin(), input.constEnd(), source.begin() + srcShift);
+        if (inPlace) {
+            std::copy(input.constBegin(), input.constEnd(), dst);
+            src = dst;
+        }
+
+        kernel(src, dst, size, key.keystream(), key.period(), offset);
+
+        for (qint64 i = 0; i < size; ++i) {
+            if (dst[i] != expected[i]) {
+                std::fprintf(stderr, "%s, key kind %d, %d bytes: mismatch at byte %lld of %lld (offset %lld, "
+                                     "src +%d, dst +%d%s)\n",
+                             XorKernel::variantName(variant), int(key.kind()), key.size(), i, size, offset,
+                             srcShift, dstShift, inPlace ? ", in place" : "");
+                return false;
+            }
+        }
+        if (dst[-1] != guard || dst[size] != guard) {
+            std::fprintf(stderr, "%s, key kind %d, %d bytes: wrote outside the buffer (size %lld)\n",
+                         XorKernel::variantName(variant), int(key.kind()), key.size(), size);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+} // namespace
+
+int main()
+{
+    QRandomGenerator random(0x5eed);
+
+    const XorKernel::Variant variants[] = { XorKernel::Scalar, XorKernel::Word64, XorKernel::Sse2,
+                                            XorKernel::Avx2, XorKernel::Avx512 };
+    const XorKey::Kind kinds[] = { XorKey::GeneralKey, XorKey::UniformKey, XorKey::IdentityKey };
+
+    int failures = 0;
+    int checked = 0;
+    for (XorKernel::Variant variant : variants) {
+        if (!XorKernel::isSupported(variant)) {
+            std::printf("%s: not supported on this CPU, skipped\n", XorKernel::variantName(variant));
+            continue;
+        }
+        for (XorKey::Kind kind : kinds) {
+            for (int length : KEY_LENGTHS) {
+                if (kind == XorKey::GeneralKey && length == 1) {
+                    continue;
+                }
+                const XorKey key = makeKey(random, length, kind);
+                if (key.kind() != kind) {
+                    std::fprintf(stderr, "key of %d bytes has kind %d, expected %d\n", length, int(key.kind()),
+                                 int(kind));
+                    ++failures;
+                    continue;
+                }
+                if (!checkCase(random, variant, key)) {
+                    ++failures;
+                }
+                ++checked;
+            }
+        }
+    }
+
+    std::printf("%d cases, %d failed\n", checked, failures);
+    return failures == 0 ? 0 : 1;
+}
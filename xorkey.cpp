@@ -0,0 +1,163 @@
+#include "xorkey.h"
+#include <QFile>
+#include <cstring>
+
+namespace {
+
+const qint64 VECTOR_SIZE = 64;
+const qint64 MIN_PERIOD = 4096;
+
+qint64 greatestCommonDivisor(qint64 a, qint64 b)
+{
+    while (b != 0) {
+        const qint64 t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+int hexDigit(QChar c)
+{
+    if (c >= '0' && c <= '9') {
+        return c.unicode() - '0';
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c.unicode() - 'A' + 10;
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c.unicode() - 'a' + 10;
+    }
+    return -1;
+}
+
+void setError(QString *error, const QString &text)
+{
+    if (error) {
+        *error = text;
+    }
+}
+
+} // namespace
+
+XorKey::XorKey()
+    : m_period(0)
+    , m_kind(GeneralKey)
+{
+}
+
+XorKey::XorKey(const QByteArray &bytes)
+    : m_bytes(bytes)
+    , m_period(0)
+    , m_kind(GeneralKey)
+{
+    if (m_bytes.isEmpty()) {
+        return;
+    }
+
+    if (m_bytes.count(m_bytes.at(0)) == m_bytes.size()) {
+        m_kind = m_bytes.at(0) == 0 ? IdentityKey : UniformKey;
+    }
+
+    const qint64 length = m_bytes.size();
+    m_period = length / greatestCommonDivisor(length, VECTOR_SIZE) * VECTOR_SIZE;
+    // Short periods would make the kernels wrap every few vectors.
+    while (m_period < MIN_PERIOD) {
+        m_period *= 2;
+    }
+
+    m_keystream.resize(m_period + PADDING);
+    char *stream = m_keystream.data();
+    for (qint64 i = 0; i < m_period; i += length) {
+        std::memcpy(stream + i, m_bytes.constData(), length);
+    }
+    std::memcpy(stream + m_period, stream, PADDING);
+}
+
+XorKey XorKey::fromHex(const QString &text, QString *error)
+{
+    QString digits = text.trimmed();
+    if (digits.startsWith("0x", Qt::CaseInsensitive)) {
+        digits = digits.mid(2);
+    }
+
+    if (digits.isEmpty()) {
+        setError(error, "Введите значение для XOR операции");
+        return XorKey();
+    }
+    if (digits.size() > 2 * MAX_SIZE) {
+        setError(error, QString("Ключ XOR не должен превышать %1 байт").arg(MAX_SIZE));
+        return XorKey();
+    }
+
+    if (digits.size() % 2 != 0) {
+        digits.prepend('0');
+    }
+
+    const int size = int(digits.size() / 2);
+    QByteArray bytes(size, Qt::Uninitialized);
+    for (int i = 0; i < size; ++i) {
+        const int high = hexDigit(digits.at(2 * i));
+        const int low = hexDigit(digits.at(2 * i + 1));
+        if (high < 0 || low < 0) {
+            setError(error, "Значение XOR должно содержать только HEX символы (0-9, A-F)");
+            return XorKey();
+        }
+        bytes[size - 1 - i] = char((high << 4) | low);
+    }
+
+    return XorKey(bytes);
+}
+
+XorKey XorKey::fromFile(const QString &filePath, QString *error)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        setError(error, "Не удалось открыть файл ключа: " + filePath);
+        return XorKey();
+    }
+
+    if (file.size() == 0) {
+        setError(error, "Файл ключа пуст");
+        return XorKey();
+    }
+    if (file.size() > MAX_SIZE) {
+        setError(error, QString("Файл ключа не должен превышать %1 байт").arg(MAX_SIZE));
+        return XorKey();
+    }
+
+    const QByteArray bytes = file.readAll();
+    if (bytes.size() != file.size()) {
+        setError(error, "Не удалось прочитать файл ключа: " + filePath);
+        return XorKey();
+    }
+
+    return XorKey(bytes);
+}
+
+XorKey XorKey::fromWord(quint64 word)
+{
+    QByteArray bytes(8, Qt::Uninitialized);
+    for (int i = 0; i < 8; ++i) {
+        bytes[i] = char(word >> (8 * i));
+    }
+    return XorKey(bytes);
+}
+
+quint64 XorKey::fingerprint() const
+{
+    if (m_bytes.size() == 8) {
+        quint64 word = 0;
+        for (int i = 7; i >= 0; --i) {
+            word = (word << 8) | static_cast<uchar>(m_bytes.at(i));
+        }
+        return word;
+    }
+
+    quint64 hash = 14695981039346656037ULL ^ quint64(m_bytes.size());
+    for (char byte : m_bytes) {
+        hash ^= static_cast<uchar>(byte);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
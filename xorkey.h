@@ -0,0 +1,53 @@
+#ifndef XORKEY_H
+#define XORKEY_H
+
+#include <QByteArray>
+#include <QString>
+
+// An XOR key of any length together with its keystream: the key repeated over a
+// period that is a multiple of both the key length and the widest vector, plus a
+// tail copy of the first PADDING bytes. Any load of up to PADDING bytes starting
+// inside the period is therefore contiguous, and kernels never wrap mid-vector.
+class XorKey
+{
+public:
+    static constexpr int MAX_SIZE = 64 * 1024;
+    static constexpr qint64 PADDING = 256;
+
+    // Keys that need less than a full keystream: all zero bytes leave the data as is,
+    // a single repeated byte fits one broadcast register.
+    enum Kind {
+        GeneralKey,
+        UniformKey,
+        IdentityKey
+    };
+
+    XorKey();
+    explicit XorKey(const QByteArray &bytes);
+
+    // Hex digits are read as a number: the rightmost byte is applied first, so a
+    // 16-digit key means the same as the former 64-bit key value.
+    static XorKey fromHex(const QString &text, QString *error = nullptr);
+    static XorKey fromFile(const QString &filePath, QString *error = nullptr);
+    static XorKey fromWord(quint64 word);
+
+    bool isNull() const { return m_bytes.isEmpty(); }
+    int size() const { return int(m_bytes.size()); }
+    Kind kind() const { return m_kind; }
+    const QByteArray &bytes() const { return m_bytes; }
+
+    // Identifies the key in journals, indexes and checkpoints. An 8-byte key keeps
+    // its former value, so files written before variable-length keys stay valid.
+    quint64 fingerprint() const;
+
+    const char *keystream() const { return m_keystream.constData(); }
+    qint64 period() const { return m_period; }
+
+private:
+    QByteArray m_bytes;
+    QByteArray m_keystream;
+    qint64 m_period;
+    Kind m_kind;
+};
+
+#endif // XORKEY_H